@@ -0,0 +1,396 @@
+#include "Benchmark.h"
+#include "QtNotepad.h"
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QKeyEvent>
+#include <QTextStream>
+#include <algorithm>
+
+static const qint64 KB = 1024;
+static const qint64 MB = 1024 * 1024;
+
+Benchmark::Benchmark(const QString& path) : window(nullptr), output(path), tolerance(20), maxSize(256 * MB)
+{
+}
+
+Benchmark::~Benchmark()
+{
+    delete window;
+}
+
+void Benchmark::setBaseline(const QString& path, double percent)
+{
+    baseline = path;
+    tolerance = percent;
+}
+
+void Benchmark::setMaxSize(qint64 bytes)
+{
+    maxSize = bytes;
+}
+
+int Benchmark::run()
+{
+    if (!dir.isValid())
+    {
+        qWarning() << "Can't create a temporary directory for the benchmark";
+        return 2;
+    }
+    window = new QtNotepad(nullptr, false);
+    window->show();
+    QApplication::processEvents();
+
+    benchOpen();
+    benchHighlight();
+    benchKeywords();
+    benchGutter();
+    benchTyping();
+    benchSave();
+
+    if (!write()) return 2;
+    return baseline.isEmpty() ? 0 : compare();
+}
+
+void Benchmark::measure(const QString& name, int iterations, qint64 bytes,
+    const std::function<void()>& body, const std::function<void()>& reset)
+{
+    QVector<double> samples;
+    QElapsedTimer timer;
+    for (int i = 0; i < iterations; ++i)
+    {
+        timer.start();
+        body();
+        samples.append(timer.nsecsElapsed() / 1e6);
+        if (reset) reset();
+        QApplication::processEvents();
+    }
+    std::sort(samples.begin(), samples.end());
+    BenchmarkResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.msecs = samples.at(samples.size() / 2);
+    result.bytes = bytes;
+    results.append(result);
+    qInfo().noquote() << QString("%1: %2 ms").arg(name).arg(result.msecs, 0, 'f', 3);
+}
+
+QString Benchmark::sampleText(int lines) const
+{
+    static const char* patterns[] =
+    {
+        "class Widget%1 : public Base\n",
+        "{\n",
+        "    int value%1 = compute(%1, \"text %1\"); // trailing comment\n",
+        "    /* block comment %1 */ for (int i = 0; i < %1; ++i) sum += i;\n",
+        "    return static_cast<double>(value%1) * 0.5;\n",
+        "};\n"
+    };
+    QString text;
+    for (int i = 0; i < lines; ++i) text += QString(patterns[i % 6]).arg(i);
+    return text;
+}
+
+QString Benchmark::sample(const QString& name, qint64 size)
+{
+    QString path = dir.filePath(name);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return QString();
+
+    QByteArray chunk = sampleText(16384).toUtf8();
+    chunk.truncate(qMin<qint64>(chunk.size(), MB));
+    for (qint64 left = size; left > 0; left -= chunk.size())
+        file.write(chunk.constData(), qMin<qint64>(left, chunk.size()));
+    return path;
+}
+
+void Benchmark::benchOpen()
+{
+    const qint64 sizes[] = { KB, MB, 16 * MB, 256 * MB, 1024 * MB };
+    for (qint64 size : sizes)
+    {
+        if (size > maxSize) break;
+        QString label = size >= MB ? QString("%1MB").arg(size / MB) : QString("%1KB").arg(size / KB);
+        QString path = sample("open-" + label + ".cpp", size);
+        if (path.isEmpty()) continue;
+
+        int iterations = size <= MB ? 10 : size <= 16 * MB ? 3 : 1;
+        measure("open/" + label, iterations, size, [&]()
+        {
+            window->openFile(path);
+        }, [&]()
+        {
+            int index = window->tabIndex(path);
+            if (index >= 0) window->closeFile(index);
+        });
+        QFile::remove(path);
+    }
+}
+
+void Benchmark::benchHighlight()
+{
+    QSharedPointer<const LanguageDefinition> language = LanguageRegistry::instance().definition("cpp");
+    if (!language) return;
+
+    QStringList lines = sampleText(20000).split('\n');
+    qint64 bytes = 0;
+    for (const QString& line : qAsConst(lines)) bytes += line.size() * qint64(sizeof(QChar));
+
+    measure("highlight/styles.xml", 5, bytes, [&]()
+    {
+        int state = 0;
+        QVector<QTextLayout::FormatRange> ranges;
+        for (const QString& line : qAsConst(lines))
+        {
+            ranges.clear();
+            state = language->highlightLine(line, state, ranges);
+        }
+    });
+}
+
+void Benchmark::benchKeywords()
+{
+    QSharedPointer<const LanguageDefinition> language = LanguageRegistry::instance().definition("cpp");
+    if (!language || language->keywords.isEmpty()) return;
+
+    LanguageDefinition table = *language;
+    table.rules.clear();
+    table.keywordPass = 0;
+    table.keywordStats.reset();
+    table.commentStartExpression = QRegularExpression();
+    table.commentEndExpression = QRegularExpression();
+
+    LanguageDefinition regex = table;
+    regex.keywordPass = -1;
+    for (auto iter = language->keywords.constBegin(); iter != language->keywords.constEnd(); ++iter)
+    {
+        HighlightingRule rule;
+        rule.pattern = QRegularExpression("\\b" + iter.key().toString() + "\\b");
+        rule.pattern.optimize();
+        rule.format = language->keywordFormats.at(iter.value());
+        rule.stats.reset(new RuleStats);
+        regex.rules.append(rule);
+    }
+
+    QStringList lines = sampleText(100000).split('\n');
+    qint64 bytes = 0;
+    for (const QString& line : qAsConst(lines)) bytes += line.size() * qint64(sizeof(QChar));
+
+    auto run = [&lines](const LanguageDefinition& definition)
+    {
+        QVector<QTextLayout::FormatRange> ranges;
+        for (const QString& line : qAsConst(lines))
+        {
+            ranges.clear();
+            definition.highlightLine(line, 0, ranges);
+        }
+    };
+    measure("keywords/regex", 5, bytes, [&]() { run(regex); });
+    measure("keywords/table", 5, bytes, [&]() { run(table); });
+}
+
+void Benchmark::benchGutter()
+{
+    const int sizes[] = { 200000, 1000000 };
+    for (int lines : sizes)
+    {
+        Editor editor;
+        editor.resize(800, 600);
+        editor.setPlainText(sampleText(lines));
+        editor.show();
+        QApplication::processEvents();
+
+        NumberArea* gutter = nullptr;
+        for (QObject* child : editor.children())
+        {
+            if ((gutter = dynamic_cast<NumberArea*>(child))) break;
+        }
+        if (!gutter) return;
+
+        QScrollBar* bar = editor.verticalScrollBar();
+        QString label = lines >= 1000000 ? QString("%1M").arg(lines / 1000000) : QString("%1k").arg(lines / 1000);
+        const int frames = 200;
+        auto scroll = [&]()
+        {
+            for (int i = 0; i < frames; ++i)
+            {
+                bar->setValue(bar->value() + bar->pageStep());
+                editor.viewport()->repaint();
+                gutter->repaint();
+            }
+        };
+        auto rewind = [&]()
+        {
+            bar->setValue(0);
+        };
+        measure("gutter/scroll-" + label, 5, frames, scroll, rewind);
+        editor.setDigitAtlas(false);
+        measure("gutter/scroll-" + label + "-text", 5, frames, scroll, rewind);
+    }
+}
+
+void Benchmark::benchTyping()
+{
+    window->createFile();
+    Editor* editor = qobject_cast<Editor*>(window->tabWgt->currentWidget());
+    if (!editor) return;
+
+    QString burst = sampleText(40);
+    measure("edit/typing", 5, burst.size(), [&]()
+    {
+        for (QChar c : qAsConst(burst))
+        {
+            int key = c == '\n' ? Qt::Key_Return : c.toUpper().unicode();
+            QString text = c == '\n' ? QString("\r") : QString(c);
+            QKeyEvent press(QEvent::KeyPress, key, Qt::NoModifier, text);
+            QKeyEvent release(QEvent::KeyRelease, key, Qt::NoModifier, text);
+            QApplication::sendEvent(editor, &press);
+            QApplication::sendEvent(editor, &release);
+        }
+    }, [&]()
+    {
+        editor->clear();
+    });
+
+    window->documents->setDirty(window->documents->idOf(editor), false);
+    window->closeFile(window->tabWgt->indexOf(editor));
+}
+
+void Benchmark::benchSave()
+{
+    qint64 size = qMin(16 * MB, maxSize);
+    QString path = sample("save.cpp", size);
+    if (path.isEmpty()) return;
+    window->openFile(path);
+
+    auto flush = [this]()
+    {
+        window->saver->waitForDone();
+        QCoreApplication::sendPostedEvents();
+    };
+    auto touchSingle = [&]()
+    {
+        Editor* editor = qobject_cast<Editor*>(window->tabWgt->widget(window->tabIndex(path)));
+        if (editor) editor->textCursor().insertText(" ");
+    };
+    touchSingle();
+    measure("save/single", 3, size, [&]()
+    {
+        window->saveFile(window->tabIndex(path));
+        flush();
+    }, touchSingle);
+    window->closeFile(window->tabIndex(path));
+
+    QStringList paths;
+    for (int i = 0; i < 8; ++i)
+    {
+        paths.append(sample(QString("save-%1.cpp").arg(i), MB));
+        window->openFile(paths.last());
+    }
+    auto touch = [&]()
+    {
+        for (const QString& file : qAsConst(paths))
+        {
+            Editor* editor = qobject_cast<Editor*>(window->tabWgt->widget(window->tabIndex(file)));
+            if (editor) editor->textCursor().insertText(" ");
+        }
+    };
+    touch();
+    measure("save/all", 3, 8 * MB, [&]()
+    {
+        window->saveAllFiles();
+        flush();
+    }, touch);
+
+    for (const QString& file : qAsConst(paths))
+    {
+        int index = window->tabIndex(file);
+        window->documents->setDirty(window->documents->idOf(window->tabWgt->widget(index)), false);
+        window->closeFile(index);
+    }
+}
+
+bool Benchmark::write() const
+{
+    QFile file(output);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "Can't write benchmark results to" << output;
+        return false;
+    }
+
+    if (output.endsWith(".csv", Qt::CaseInsensitive))
+    {
+        QTextStream stream(&file);
+        stream << "name,iterations,msecs,bytes\n";
+        for (const BenchmarkResult& result : results)
+            stream << result.name << ',' << result.iterations << ',' << QString::number(result.msecs, 'f', 3) << ',' << result.bytes << '\n';
+        return true;
+    }
+
+    QJsonArray array;
+    for (const BenchmarkResult& result : results)
+    {
+        QJsonObject object;
+        object.insert("name", result.name);
+        object.insert("iterations", result.iterations);
+        object.insert("msecs", result.msecs);
+        object.insert("bytes", result.bytes);
+        array.append(object);
+    }
+    QJsonObject root;
+    root.insert("qt", QString(qVersion()));
+    root.insert("platform", QApplication::platformName());
+    root.insert("results", array);
+    file.write(QJsonDocument(root).toJson());
+    return true;
+}
+
+QHash<QString, double> Benchmark::readResults(const QString& path)
+{
+    QHash<QString, double> values;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return values;
+
+    if (path.endsWith(".csv", Qt::CaseInsensitive))
+    {
+        file.readLine();
+        while (!file.atEnd())
+        {
+            QStringList fields = QString::fromUtf8(file.readLine()).trimmed().split(',');
+            if (fields.size() >= 3) values.insert(fields.at(0), fields.at(2).toDouble());
+        }
+        return values;
+    }
+
+    const QJsonArray array = QJsonDocument::fromJson(file.readAll()).object().value("results").toArray();
+    for (const QJsonValue& value : array)
+        values.insert(value.toObject().value("name").toString(), value.toObject().value("msecs").toDouble());
+    return values;
+}
+
+int Benchmark::compare() const
+{
+    QHash<QString, double> previous = readResults(baseline);
+    if (previous.isEmpty())
+    {
+        qWarning() << "Can't read benchmark baseline" << baseline;
+        return 2;
+    }
+
+    int regressions = 0;
+    for (const BenchmarkResult& result : results)
+    {
+        if (!previous.contains(result.name)) continue;
+        double limit = previous.value(result.name) * (1 + tolerance / 100);
+        if (result.msecs > limit && result.msecs - previous.value(result.name) > 1)
+        {
+            qWarning().noquote() << QString("Regression in %1: %2 ms, baseline %3 ms")
+                .arg(result.name).arg(result.msecs, 0, 'f', 3).arg(previous.value(result.name), 0, 'f', 3);
+            ++regressions;
+        }
+    }
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QTemporaryDir>
+#include <functional>
+
+class QtNotepad;
+
+struct BenchmarkResult
+{
+    QString name;
+    int iterations;
+    double msecs;
+    qint64 bytes;
+};
+
+class Benchmark
+{
+public:
+    explicit Benchmark(const QString&);
+    ~Benchmark();
+
+    void setBaseline(const QString&, double tolerance = 20);
+    void setMaxSize(qint64);
+    int run();
+
+private:
+    void measure(const QString&, int, qint64, const std::function<void()>&, const std::function<void()>& reset = nullptr);
+    QString sample(const QString&, qint64);
+    QString sampleText(int) const;
+
+    void benchOpen();
+    void benchHighlight();
+    void benchKeywords();
+    void benchGutter();
+    void benchTyping();
+    void benchSave();
+
+    bool write() const;
+    int compare() const;
+    static QHash<QString, double> readResults(const QString&);
+
+    QtNotepad* window;
+    QTemporaryDir dir;
+    QVector<BenchmarkResult> results;
+    QString output;
+    QString baseline;
+    double tolerance;
+    qint64 maxSize;
+};
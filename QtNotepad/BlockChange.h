@@ -0,0 +1,37 @@
+#pragma once
+#include <QTextDocument>
+#include <QTextBlock>
+#include <QVector>
+
+// Maps a contentsChange onto a cache with one entry per block: entries
+// [first, oldLast] of the cache were replaced by blocks [first, last].
+struct BlockChange
+{
+    QTextBlock firstBlock;
+    int first = 0;
+    int last = 0;
+    int oldLast = 0;
+
+    // Returns false when the cache can't be patched and has to be rebuilt.
+    bool map(const QTextDocument* document, int position, int added, int cached)
+    {
+        firstBlock = document->findBlock(position);
+        QTextBlock lastBlock = document->findBlock(position + added);
+        if (!firstBlock.isValid()) firstBlock = document->lastBlock();
+        if (!lastBlock.isValid()) lastBlock = document->lastBlock();
+
+        first = firstBlock.blockNumber();
+        last = lastBlock.blockNumber();
+        oldLast = last - (document->blockCount() - cached);
+        return first <= last && oldLast >= first - 1 && oldLast < cached;
+    }
+
+    template <typename T>
+    void resize(QVector<T>& cache) const
+    {
+        int removed = oldLast - first + 1;
+        int inserted = last - first + 1;
+        if (inserted > removed) cache.insert(first, inserted - removed, T());
+        else if (inserted < removed) cache.remove(first, removed - inserted);
+    }
+};
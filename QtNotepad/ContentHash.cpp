@@ -0,0 +1,124 @@
+#include "ContentHash.h"
+#include "BlockChange.h"
+#include "Trace.h"
+#include <QStringView>
+
+// The document hash is the sum of a mix of every pair of adjacent lines,
+// so an edit only touches the terms around the lines it changed. A sum can
+// collide when lines are reordered, so a match is confirmed with an ordered
+// fold over the cached line hashes before the document is reported clean.
+
+static const quint64 startMark = 0x9e3779b97f4a7c15ULL;
+static const quint64 endMark = 0xc2b2ae3d27d4eb4fULL;
+
+static inline quint64 mix(quint64 value)
+{
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+static inline quint64 lineHash(QStringView text)
+{
+    return mix(quint64(qHash(text, size_t(startMark))) ^ (quint64(text.size()) << 32));
+}
+
+ContentHash::ContentHash(QTextDocument* textDocument, QObject* parent) : QObject(parent),
+    document(textDocument), sum(0), changes(0), checkedAt(-1), checkedResult(false)
+{
+    rebuild();
+    connect(document, SIGNAL(contentsChange(int, int, int)), SLOT(contentsChange(int, int, int)));
+}
+
+quint64 ContentHash::term(const QVector<quint64>& lines, int index)
+{
+    quint64 previous = index == 0 ? startMark : lines.at(index - 1);
+    quint64 current = index == lines.size() ? endMark : lines.at(index);
+    return mix(previous * 0xff51afd7ed558ccdULL + (current ^ (current >> 29)));
+}
+
+quint64 ContentHash::ordered(const QVector<quint64>& lines)
+{
+    quint64 value = startMark;
+    for (quint64 hash : lines) value = mix(value + hash);
+    return value;
+}
+
+void ContentHash::rebuild()
+{
+    hashes.clear();
+    hashes.reserve(document->blockCount());
+    for (QTextBlock block = document->begin(); block.isValid(); block = block.next()) hashes.append(lineHash(block.text()));
+    sum = 0;
+    for (int i = 0; i <= hashes.size(); ++i) sum += term(hashes, i);
+}
+
+void ContentHash::contentsChange(int position, int, int added)
+{
+    TRACE_SCOPE("ContentHash::contentsChange");
+    ++changes;
+    BlockChange change;
+    if (!change.map(document, position, added, hashes.size()))
+    {
+        rebuild();
+        return;
+    }
+
+    for (int i = change.first; i <= change.oldLast + 1; ++i) sum -= term(hashes, i);
+    change.resize(hashes);
+
+    QTextBlock block = change.firstBlock;
+    for (int i = change.first; i <= change.last; ++i, block = block.next()) hashes[i] = lineHash(block.text());
+    for (int i = change.first; i <= change.last + 1; ++i) sum += term(hashes, i);
+}
+
+bool ContentHash::isModified() const
+{
+    if (!savedDigest.valid || sum != savedDigest.sum) return true;
+    if (checkedAt != changes)
+    {
+        checkedAt = changes;
+        checkedResult = ordered(hashes) != savedDigest.ordered;
+    }
+    return checkedResult;
+}
+
+void ContentHash::markSaved()
+{
+    savedDigest.sum = sum;
+    savedDigest.ordered = ordered(hashes);
+    savedDigest.valid = true;
+    checkedAt = changes;
+    checkedResult = false;
+}
+
+ContentDigest ContentHash::digest(const QString& text)
+{
+    QVector<quint64> lines;
+    qsizetype start = 0;
+    for (qsizetype end = text.indexOf(QLatin1Char('\n')); end >= 0; end = text.indexOf(QLatin1Char('\n'), start))
+    {
+        lines.append(lineHash(QStringView(text).mid(start, end - start)));
+        start = end + 1;
+    }
+    lines.append(lineHash(QStringView(text).mid(start)));
+
+    ContentDigest result;
+    for (int i = 0; i <= lines.size(); ++i) result.sum += term(lines, i);
+    result.ordered = ordered(lines);
+    result.valid = true;
+    return result;
+}
+
+ContentDigest ContentHash::saved() const
+{
+    return savedDigest;
+}
+
+void ContentHash::setSaved(const ContentDigest& digest)
+{
+    savedDigest = digest;
+    checkedAt = -1;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <QObject>
+#include <QTextDocument>
+#include <QVector>
+
+struct ContentDigest
+{
+    quint64 sum = 0;
+    quint64 ordered = 0;
+    bool valid = false;
+};
+
+class ContentHash : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ContentHash(QTextDocument*, QObject* parent = nullptr);
+
+    bool isModified() const;
+    void markSaved();
+    ContentDigest saved() const;
+    void setSaved(const ContentDigest&);
+    static ContentDigest digest(const QString&);
+
+private slots:
+    void contentsChange(int, int, int);
+
+private:
+    void rebuild();
+    static quint64 term(const QVector<quint64>&, int);
+    static quint64 ordered(const QVector<quint64>&);
+
+    QTextDocument* document;
+    QVector<quint64> hashes;
+    quint64 sum;
+    ContentDigest savedDigest;
+    int changes;
+    mutable int checkedAt;
+    mutable bool checkedResult;
+};
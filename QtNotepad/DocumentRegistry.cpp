@@ -0,0 +1,173 @@
+#include "DocumentRegistry.h"
+#include <QDir>
+#include <QFileInfo>
+
+DocumentRegistry::DocumentRegistry(QObject* parent) : QObject(parent), nextId(1)
+{
+}
+
+QString DocumentRegistry::key(const QString& path)
+{
+    if (path.isEmpty()) return QString();
+    QFileInfo info(path);
+    QString canonical = info.canonicalFilePath();
+    if (canonical.isEmpty()) canonical = QDir::cleanPath(info.absoluteFilePath());
+#ifdef Q_OS_WIN
+    canonical = canonical.toLower();
+#endif
+    return canonical;
+}
+
+quint64 DocumentRegistry::add(QWidget* page, const QString& path, const QString& name, bool modified)
+{
+    quint64 id = nextId++;
+    Document& document = documents[id];
+    document.page = page;
+    document.path = path;
+    document.name = name;
+    document.key = key(path);
+    document.dirty = modified;
+    if (!document.key.isEmpty() && !byPath.contains(document.key))
+    {
+        byPath.insert(document.key, id);
+        byRawPath.insert(path, id);
+    }
+    if (page) byPage.insert(page, id);
+    if (modified) dirty.insert(id);
+    return id;
+}
+
+void DocumentRegistry::remove(quint64 id)
+{
+    auto it = documents.find(id);
+    if (it == documents.end()) return;
+    if (!it->key.isEmpty() && byPath.value(it->key) == id)
+    {
+        byPath.remove(it->key);
+        byRawPath.remove(it->path);
+    }
+    byPage.remove(it->page);
+    dirty.remove(id);
+    documents.erase(it);
+}
+
+void DocumentRegistry::clear()
+{
+    documents.clear();
+    byPath.clear();
+    byRawPath.clear();
+    byPage.clear();
+    dirty.clear();
+}
+
+void DocumentRegistry::setPage(quint64 id, QWidget* page)
+{
+    auto it = documents.find(id);
+    if (it == documents.end() || it->page == page) return;
+    byPage.remove(it->page);
+    it->page = page;
+    if (page) byPage.insert(page, id);
+}
+
+bool DocumentRegistry::setPath(quint64 id, const QString& path, const QString& name)
+{
+    auto it = documents.find(id);
+    if (it == documents.end()) return false;
+    QString pathKey = key(path);
+    quint64 owner = byPath.value(pathKey);
+    if (!pathKey.isEmpty() && owner && owner != id) return false;
+
+    if (!it->key.isEmpty() && byPath.value(it->key) == id)
+    {
+        byPath.remove(it->key);
+        byRawPath.remove(it->path);
+    }
+    it->path = path;
+    it->name = name;
+    it->key = pathKey;
+    if (!it->key.isEmpty())
+    {
+        byPath.insert(it->key, id);
+        byRawPath.insert(path, id);
+    }
+    emit changed(id);
+    return true;
+}
+
+void DocumentRegistry::setDirty(quint64 id, bool modified)
+{
+    auto it = documents.find(id);
+    if (it == documents.end() || it->dirty == modified) return;
+    it->dirty = modified;
+    if (modified) dirty.insert(id);
+    else dirty.remove(id);
+    emit changed(id);
+}
+
+quint64 DocumentRegistry::idOf(QWidget* page) const
+{
+    return byPage.value(page);
+}
+
+quint64 DocumentRegistry::find(const QString& path) const
+{
+    if (path.isEmpty()) return 0;
+    auto raw = byRawPath.constFind(path);
+    return raw != byRawPath.cend() ? raw.value() : byPath.value(key(path));
+}
+
+QWidget* DocumentRegistry::page(quint64 id) const
+{
+    auto it = documents.constFind(id);
+    return it == documents.cend() ? nullptr : it->page;
+}
+
+QString DocumentRegistry::path(quint64 id) const
+{
+    auto it = documents.constFind(id);
+    return it == documents.cend() ? QString() : it->path;
+}
+
+QString DocumentRegistry::name(quint64 id) const
+{
+    auto it = documents.constFind(id);
+    return it == documents.cend() ? QString() : it->name;
+}
+
+QString DocumentRegistry::title(quint64 id) const
+{
+    auto it = documents.constFind(id);
+    if (it == documents.cend()) return QString();
+    return it->dirty ? it->name + "*" : it->name;
+}
+
+bool DocumentRegistry::isDirty(quint64 id) const
+{
+    return dirty.contains(id);
+}
+
+bool DocumentRegistry::hasDirty() const
+{
+    return !dirty.isEmpty();
+}
+
+QList<quint64> DocumentRegistry::dirtyDocuments() const
+{
+    return dirty.values();
+}
+
+QStringList DocumentRegistry::paths() const
+{
+    QStringList list;
+    list.reserve(byPath.size());
+    for (auto it = documents.cbegin(); it != documents.cend(); ++it)
+    {
+        if (!it->path.isEmpty()) list.append(it->path);
+    }
+    return list;
+}
+
+int DocumentRegistry::count() const
+{
+    return documents.size();
+}
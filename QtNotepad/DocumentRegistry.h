@@ -0,0 +1,56 @@
+#pragma once
+#include <QObject>
+#include <QWidget>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QList>
+
+struct Document
+{
+    QWidget* page = nullptr;
+    QString path;
+    QString name;
+    QString key;
+    bool dirty = false;
+};
+
+class DocumentRegistry : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DocumentRegistry(QObject* parent = nullptr);
+
+    quint64 add(QWidget*, const QString&, const QString&, bool dirty = false);
+    void remove(quint64);
+    void clear();
+    void setPage(quint64, QWidget*);
+    bool setPath(quint64, const QString&, const QString&);
+    void setDirty(quint64, bool);
+
+    quint64 idOf(QWidget*) const;
+    quint64 find(const QString&) const;
+    QWidget* page(quint64) const;
+    QString path(quint64) const;
+    QString name(quint64) const;
+    QString title(quint64) const;
+    bool isDirty(quint64) const;
+    bool hasDirty() const;
+    QList<quint64> dirtyDocuments() const;
+    QStringList paths() const;
+    int count() const;
+
+    static QString key(const QString&);
+
+signals:
+    void changed(quint64);
+
+private:
+    QHash<quint64, Document> documents;
+    QHash<QString, quint64> byPath;
+    QHash<QString, quint64> byRawPath;
+    QHash<QWidget*, quint64> byPage;
+    QSet<quint64> dirty;
+    quint64 nextId;
+};
@@ -0,0 +1,239 @@
+#include "EditJournal.h"
+#include <QTextCursor>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include <QUuid>
+
+static const quint32 journalMagic = 0x514e4a31;
+static const qint64 compactBytes = 4 * 1024 * 1024;
+static const int flushInterval = 1000;
+
+enum RecordType : quint8 { EditRecord = 1, CheckpointRecord = 2 };
+
+static QThreadPool* writer()
+{
+    static QThreadPool* pool = []()
+    {
+        QThreadPool* threads = new QThreadPool;
+        threads->setMaxThreadCount(1);
+        return threads;
+    }();
+    return pool;
+}
+
+EditJournal::EditJournal(QTextDocument* parentDocument, QObject* parent) : QObject(parent),
+    document(parentDocument), baseSize(-1), written(0), started(false)
+{
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    timer->setInterval(flushInterval);
+    connect(timer, SIGNAL(timeout()), SLOT(flush()));
+    connect(document, SIGNAL(contentsChange(int, int, int)), SLOT(recordChange(int, int, int)));
+}
+
+EditJournal::~EditJournal()
+{
+    discard();
+}
+
+QString EditJournal::directory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/journal";
+}
+
+void EditJournal::waitForWrites()
+{
+    writer()->waitForDone();
+}
+
+void EditJournal::remove(const QString& name)
+{
+    writer()->start([name]() { QFile::remove(name); });
+}
+
+void EditJournal::setSource(const QString& path, const QString& title)
+{
+    bool changed = path != sourcePath || title != sourceTitle;
+    sourcePath = path;
+    sourceTitle = title;
+    if (started && changed) checkpoint();
+}
+
+void EditJournal::reset()
+{
+    discard();
+    QFileInfo info(sourcePath);
+    baseSize = info.exists() ? info.size() : -1;
+    baseModified = info.exists() ? info.lastModified() : QDateTime();
+}
+
+void EditJournal::discard()
+{
+    timer->stop();
+    pending.clear();
+    if (started) remove(fileName);
+    started = false;
+    written = 0;
+}
+
+QByteArray EditJournal::header() const
+{
+    QByteArray bytes;
+    QDataStream stream(&bytes, QIODevice::WriteOnly);
+    stream << journalMagic << sourcePath << sourceTitle << baseSize << baseModified;
+    return bytes;
+}
+
+void EditJournal::enqueue(const QByteArray& bytes, bool truncate)
+{
+    QString name = fileName;
+    written = truncate ? bytes.size() : written + bytes.size();
+    writer()->start([name, bytes, truncate]()
+    {
+        QDir().mkpath(QFileInfo(name).path());
+        QFile file(name);
+        if (!file.open(truncate ? QIODevice::WriteOnly | QIODevice::Truncate : QIODevice::WriteOnly | QIODevice::Append)) return;
+        file.write(bytes);
+        file.flush();
+    });
+}
+
+void EditJournal::checkpoint()
+{
+    if (!document) return;
+    if (fileName.isEmpty()) fileName = directory() + "/" + QUuid::createUuid().toString(QUuid::WithoutBraces) + ".journal";
+    timer->stop();
+    pending.clear();
+
+    QByteArray bytes = header();
+    QDataStream stream(&bytes, QIODevice::WriteOnly | QIODevice::Append);
+    QString text = document->toRawText();
+    text.replace(QChar::ParagraphSeparator, '\n');
+    stream << quint8(CheckpointRecord) << qCompress(text.toUtf8(), 1);
+    enqueue(bytes, true);
+    started = true;
+}
+
+void EditJournal::recordChange(int position, int removed, int added)
+{
+    if (!document->isUndoRedoEnabled()) return;
+    if (!started)
+    {
+        if (fileName.isEmpty()) fileName = directory() + "/" + QUuid::createUuid().toString(QUuid::WithoutBraces) + ".journal";
+        if (baseSize < 0 && !sourcePath.isEmpty())
+        {
+            QFileInfo info(sourcePath);
+            baseSize = info.size();
+            baseModified = info.lastModified();
+        }
+        pending = header();
+        written = 0;
+        started = true;
+    }
+
+    QTextCursor cursor(document);
+    cursor.setPosition(position);
+    cursor.setPosition(qMin(position + added, document->characterCount() - 1), QTextCursor::KeepAnchor);
+    QString inserted = cursor.selectedText();
+    inserted.replace(QChar::ParagraphSeparator, '\n');
+
+    QDataStream stream(&pending, QIODevice::WriteOnly | QIODevice::Append);
+    stream << quint8(EditRecord) << qint32(position) << qint32(removed) << inserted;
+    if (!timer->isActive()) timer->start();
+}
+
+void EditJournal::flush()
+{
+    timer->stop();
+    if (pending.isEmpty()) return;
+    QByteArray bytes = pending;
+    pending.clear();
+    enqueue(bytes, false);
+    if (document && written > compactBytes && written > document->characterCount() * qint64(sizeof(QChar))) checkpoint();
+}
+
+QVector<RecoveredDocument> EditJournal::recover(int* skipped)
+{
+    QVector<RecoveredDocument> documents;
+    if (skipped) *skipped = 0;
+
+    const QFileInfoList journals = QDir(directory()).entryInfoList(QStringList() << "*.journal", QDir::Files, QDir::Time | QDir::Reversed);
+    for (const QFileInfo& journal : journals)
+    {
+        QFile file(journal.absoluteFilePath());
+        if (!file.open(QIODevice::ReadOnly)) continue;
+        QDataStream stream(&file);
+
+        quint32 magic = 0;
+        RecoveredDocument recovered;
+        qint64 size = -1;
+        QDateTime modified;
+        stream >> magic >> recovered.path >> recovered.title >> size >> modified;
+        if (stream.status() != QDataStream::Ok || magic != journalMagic) continue;
+
+        struct Edit
+        {
+            qint32 position;
+            qint32 removed;
+            QString inserted;
+        };
+        QVector<Edit> edits;
+        QByteArray base;
+        bool hasBase = false;
+        while (!stream.atEnd())
+        {
+            quint8 type = 0;
+            stream >> type;
+            if (type == CheckpointRecord)
+            {
+                QByteArray data;
+                stream >> data;
+                if (stream.status() != QDataStream::Ok) break;
+                base = data;
+                hasBase = true;
+                edits.clear();
+            }
+            else if (type == EditRecord)
+            {
+                Edit edit;
+                stream >> edit.position >> edit.removed >> edit.inserted;
+                if (stream.status() != QDataStream::Ok) break;
+                edits.append(edit);
+            }
+            else break;
+        }
+
+        if (hasBase)
+        {
+            recovered.text = QString::fromUtf8(qUncompress(base));
+            QFile source(recovered.path);
+            if (!recovered.path.isEmpty() && source.open(QIODevice::ReadOnly)) recovered.format = FileCodec::detect(source.readAll());
+        }
+        else if (!recovered.path.isEmpty())
+        {
+            QFileInfo info(recovered.path);
+            QFile source(recovered.path);
+            if (info.size() != size || info.lastModified() != modified || !source.open(QIODevice::ReadOnly))
+            {
+                if (skipped) ++*skipped;
+                continue;
+            }
+            recovered.text = FileCodec::decodeAll(source.readAll(), &recovered.format);
+        }
+        if (edits.isEmpty() && !hasBase) continue;
+
+        for (const Edit& edit : qAsConst(edits))
+        {
+            int position = qBound(0, int(edit.position), int(recovered.text.size()));
+            recovered.text.remove(position, qMin(int(edit.removed), int(recovered.text.size()) - position));
+            recovered.text.insert(position, edit.inserted);
+        }
+        recovered.journal = journal.absoluteFilePath();
+        documents.append(recovered);
+    }
+    return documents;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "FileCodec.h"
+#include <QObject>
+#include <QTextDocument>
+#include <QByteArray>
+#include <QDateTime>
+#include <QVector>
+#include <QTimer>
+#include <QPointer>
+
+struct RecoveredDocument
+{
+    QString path;
+    QString title;
+    QString text;
+    QString journal;
+    TextFormat format;
+};
+
+class EditJournal : public QObject
+{
+    Q_OBJECT
+public:
+    explicit EditJournal(QTextDocument*, QObject* parent = nullptr);
+    ~EditJournal();
+
+    void setSource(const QString&, const QString&);
+    void reset();
+    void discard();
+    void checkpoint();
+
+    static QString directory();
+    static QVector<RecoveredDocument> recover(int* skipped = nullptr);
+    static void remove(const QString&);
+    static void waitForWrites();
+
+private slots:
+    void recordChange(int, int, int);
+    void flush();
+
+private:
+    QByteArray header() const;
+    void enqueue(const QByteArray&, bool);
+
+    QPointer<QTextDocument> document;
+    QTimer* timer;
+    QString fileName;
+    QString sourcePath;
+    QString sourceTitle;
+    qint64 baseSize;
+    QDateTime baseModified;
+    QByteArray pending;
+    qint64 written;
+    bool started;
+};
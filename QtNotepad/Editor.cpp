@@ -1,16 +1,33 @@
 #include "Editor.h"
+#include "Trace.h"
 #include <QPainter>
 #include <QTextBlock>
+#include <QKeyEvent>
+#include <QMenu>
 #include "NumberArea.h"
+#include <algorithm>
 
 
 Editor::Editor(QWidget* parent) : QPlainTextEdit(parent)
 {
-    lineNumberArea = new NumberArea(this);
+    lineNumberArea = new NumberArea(this, this);
+    visibleFirst = -1;
+    visibleLast = -1;
+    changes = 0;
+    atlasRatio = 0;
+    atlasEnabled = true;
+    numberDigits = 0;
+    gutterWidth = -1;
+    updateDigitAtlas();
+    history = new UndoHistory(document(), this);
+    editJournal = new EditJournal(document(), this);
+    hash = new ContentHash(document(), this);
+    stats = new TextStats(document(), this);
 
     connect(this, SIGNAL(blockCountChanged(int)), SLOT(changeLineNumberAreaWidth(int)));
     connect(this, SIGNAL(updateRequest(QRect, int)), SLOT(changeLineNumberArea(QRect, int)));
     connect(this, SIGNAL(cursorPositionChanged()), SLOT(currLine()));
+    connect(this, SIGNAL(textChanged()), SLOT(countChange()));
 
     changeLineNumberAreaWidth(0);
     currLine();
@@ -18,19 +35,175 @@ Editor::Editor(QWidget* parent) : QPlainTextEdit(parent)
 
 int Editor::lineNumberAreaWidth()
 {
-    int numbers = 1;
-    int m = qMax(1, blockCount());
-    while (m >= 10)
+    return 3 + qMax(1, numberDigits) * digitWidth;
+}
+
+void Editor::updateDigitAtlas()
+{
+    qreal ratio = devicePixelRatioF();
+    if (!digitAtlas.isNull() && atlasFont == font() && atlasRatio == ratio) return;
+
+    atlasFont = font();
+    atlasRatio = ratio;
+    digitWidth = fontMetrics().horizontalAdvance(QLatin1Char('9'));
+    digitHeight = fontMetrics().height();
+
+    digitAtlas = QPixmap(QSize(digitWidth * 10, digitHeight) * ratio);
+    digitAtlas.setDevicePixelRatio(ratio);
+    digitAtlas.fill(Qt::transparent);
+    QPainter painter(&digitAtlas);
+    painter.setFont(atlasFont);
+    painter.setPen(Qt::black);
+    for (int i = 0; i < 10; ++i)
+        painter.drawText(QRect(i * digitWidth, 0, digitWidth, digitHeight), Qt::AlignCenter, QString::number(i));
+}
+
+void Editor::setDigitAtlas(bool enabled)
+{
+    atlasEnabled = enabled;
+    lineNumberArea->update();
+}
+
+UndoHistory* Editor::undoHistory() const
+{
+    return history;
+}
+
+EditJournal* Editor::journal() const
+{
+    return editJournal;
+}
+
+ContentHash* Editor::contentHash() const
+{
+    return hash;
+}
+
+TextStats* Editor::textStats() const
+{
+    return stats;
+}
+
+TextFormat Editor::textFormat() const
+{
+    return format;
+}
+
+void Editor::setTextFormat(const TextFormat& textFormat)
+{
+    format = textFormat;
+}
+
+QString Editor::fileText() const
+{
+    QString text = document()->toRawText();
+    for (QChar& c : text)
+    {
+        if (c == QChar::ParagraphSeparator || c == QChar::LineSeparator) c = QLatin1Char('\n');
+    }
+    return text;
+}
+
+void Editor::undoStep()
+{
+    if (!document()->isUndoAvailable() && history->undo()) return;
+    undo();
+}
+
+void Editor::keyPressEvent(QKeyEvent* event)
+{
+    if (event->matches(QKeySequence::Undo) && !isReadOnly())
     {
-        m /= 10;
-        ++numbers;
+        undoStep();
+        return;
     }
-    return 3 + numbers * fontMetrics().horizontalAdvance(QLatin1Char('9'));
+    QPlainTextEdit::keyPressEvent(event);
+}
+
+void Editor::contextMenuEvent(QContextMenuEvent* event)
+{
+    QMenu* menu = createStandardContextMenu(event->pos());
+    if (QAction* action = menu->findChild<QAction*>("edit-undo"))
+    {
+        action->disconnect();
+        action->setEnabled(!isReadOnly() && (document()->isUndoAvailable() || history->canUndo()));
+        connect(action, SIGNAL(triggered()), SLOT(undoStep()));
+    }
+    menu->exec(event->globalPos());
+    delete menu;
+}
+
+void Editor::paintEvent(QPaintEvent* event)
+{
+    TRACE_SCOPE("Editor::paintEvent");
+    QPlainTextEdit::paintEvent(event);
+}
+
+void Editor::changeEvent(QEvent* event)
+{
+    QPlainTextEdit::changeEvent(event);
+    if (event->type() != QEvent::FontChange) return;
+    updateDigitAtlas();
+    gutterWidth = -1;
+    changeLineNumberAreaWidth(0);
+    lineNumberArea->update();
+}
+
+int Editor::revision() const
+{
+    return changes;
+}
+
+void Editor::countChange()
+{
+    ++changes;
+    if (!searchMatches.isEmpty()) clearSearchMatches();
+}
+
+void Editor::appendSearchMatches(const QVector<SearchMatch>& matches)
+{
+    searchMatches += matches;
+    currLine();
+}
+
+void Editor::clearSearchMatches()
+{
+    searchMatches.clear();
+    currLine();
+}
+
+int Editor::searchMatchCount() const
+{
+    return searchMatches.size();
+}
+
+bool Editor::findNext(bool backward)
+{
+    if (searchMatches.isEmpty()) return false;
+
+    auto before = [](const SearchMatch& match, int position) { return match.position < position; };
+    QTextCursor cursor = textCursor();
+    auto iter = std::lower_bound(searchMatches.constBegin(), searchMatches.constEnd(),
+        backward ? cursor.selectionStart() : cursor.selectionEnd(), before);
+    if (backward) iter = iter == searchMatches.constBegin() ? searchMatches.constEnd() - 1 : iter - 1;
+    else if (iter == searchMatches.constEnd()) iter = searchMatches.constBegin();
+
+    cursor.setPosition(iter->position);
+    cursor.setPosition(iter->position + iter->length, QTextCursor::KeepAnchor);
+    setTextCursor(cursor);
+    return true;
 }
 
 void Editor::changeLineNumberAreaWidth(int)
 {
-    setViewportMargins(lineNumberAreaWidth(), 0, 0, 0);
+    int digits = 1;
+    for (int m = qMax(1, blockCount()); m >= 10; m /= 10) ++digits;
+    numberDigits = digits;
+
+    int width = lineNumberAreaWidth();
+    if (width == gutterWidth) return;
+    gutterWidth = width;
+    setViewportMargins(width, 0, 0, 0);
 }
 
 void Editor::changeLineNumberArea(const QRect& rect, int n)
@@ -38,6 +211,31 @@ void Editor::changeLineNumberArea(const QRect& rect, int n)
     if (n) lineNumberArea->scroll(0, n);
     else lineNumberArea->update(0, rect.y(), lineNumberArea->width(), rect.height());
     if (rect.contains(viewport()->rect())) changeLineNumberAreaWidth(0);
+    if (n || rect.contains(viewport()->rect())) updateVisibleBlocks();
+}
+
+void Editor::updateVisibleBlocks()
+{
+    TRACE_SCOPE("Editor::updateVisibleBlocks");
+    QTextBlock block = firstVisibleBlock();
+    int first = block.blockNumber();
+    int last = first;
+    int top = (int)blockBoundingGeometry(block).translated(contentOffset()).top();
+    int height = viewport()->height();
+
+    while (block.isValid() && top <= height)
+    {
+        top += (int)blockBoundingRect(block).height();
+        block = block.next();
+        ++last;
+    }
+    if (last > first) --last;
+    if (first == visibleFirst && last == visibleLast) return;
+
+    visibleFirst = first;
+    visibleLast = last;
+    if (!searchMatches.isEmpty()) currLine();
+    emit visibleBlocksChanged(first, last);
 }
 
 void Editor::resizeEvent(QResizeEvent* event)
@@ -45,10 +243,12 @@ void Editor::resizeEvent(QResizeEvent* event)
     QPlainTextEdit::resizeEvent(event);
     QRect rect = contentsRect();
     lineNumberArea->setGeometry(QRect(rect.left(), rect.top(), lineNumberAreaWidth(), rect.height()));
+    updateVisibleBlocks();
 }
 
 void Editor::currLine()
 {
+    TRACE_SCOPE("Editor::currLine");
     QList<QTextEdit::ExtraSelection> selections;
     if (!isReadOnly())
     {
@@ -59,16 +259,38 @@ void Editor::currLine()
         selection.cursor.clearSelection();
         selections.append(selection);
     }
+
+    if (!searchMatches.isEmpty() && visibleFirst >= 0)
+    {
+        QTextBlock last = document()->findBlockByNumber(visibleLast);
+        int from = document()->findBlockByNumber(visibleFirst).position();
+        int to = last.isValid() ? last.position() + last.length() : document()->characterCount();
+        auto iter = std::lower_bound(searchMatches.constBegin(), searchMatches.constEnd(), from,
+            [](const SearchMatch& match, int position) { return match.position + match.length < position; });
+
+        QTextEdit::ExtraSelection selection;
+        selection.format.setBackground(QColor(255, 150, 50));
+        selection.cursor = QTextCursor(document());
+        for (; iter != searchMatches.constEnd() && iter->position < to; ++iter)
+        {
+            selection.cursor.setPosition(iter->position);
+            selection.cursor.setPosition(iter->position + iter->length, QTextCursor::KeepAnchor);
+            selections.append(selection);
+        }
+    }
     setExtraSelections(selections);
 }
 
 void Editor::lineNumberAreaPaintEvent(QPaintEvent* event)
 {
+    TRACE_SCOPE("Editor::lineNumberAreaPaintEvent");
+    updateDigitAtlas();
     QPainter painter(lineNumberArea);
     QTextBlock block = firstVisibleBlock();
     int top = (int)blockBoundingGeometry(block).translated(contentOffset()).top();
     int bottom = top + (int)blockBoundingRect(block).height();
     int number = block.blockNumber();
+    int right = lineNumberArea->width();
 
     painter.fillRect(event->rect(), Qt::lightGray);
 
@@ -76,9 +298,23 @@ void Editor::lineNumberAreaPaintEvent(QPaintEvent* event)
     {
         if (block.isVisible() && bottom >= event->rect().top())
         {
-            painter.setPen(Qt::black);
-            painter.drawText(0, top, lineNumberArea->width(), fontMetrics().height(),
-                Qt::AlignRight, QString::number(number + 1));
+            if (!atlasEnabled)
+            {
+                painter.setPen(Qt::black);
+                painter.drawText(0, top, right, digitHeight, Qt::AlignRight, QString::number(number + 1));
+            }
+            else
+            {
+                int x = right;
+                int value = number + 1;
+                do
+                {
+                    x -= digitWidth;
+                    QRectF source((value % 10) * digitWidth * atlasRatio, 0, digitWidth * atlasRatio, digitHeight * atlasRatio);
+                    painter.drawPixmap(QPointF(x, top), digitAtlas, source);
+                    value /= 10;
+                } while (value > 0);
+            }
         }
         block = block.next();
         top = bottom;
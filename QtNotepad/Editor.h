@@ -3,24 +3,78 @@
 #include <QPlainTextEdit>
 #include <QPainter>
 #include <QTextBlock>
+#include <QPixmap>
+#include "NumberArea.h"
+#include "SearchEngine.h"
+#include "UndoHistory.h"
+#include "EditJournal.h"
+#include "FileCodec.h"
+#include "ContentHash.h"
+#include "TextStats.h"
 
 
-class Editor : public QPlainTextEdit
+class Editor : public QPlainTextEdit, public LineNumberSource
 {
     Q_OBJECT
         QWidget* lineNumberArea;
 public:
     Editor(QWidget* parent = nullptr);
 
-    void lineNumberAreaPaintEvent(QPaintEvent*);
-    int lineNumberAreaWidth();
+    void lineNumberAreaPaintEvent(QPaintEvent*) override;
+    int lineNumberAreaWidth() override;
+    int revision() const;
+
+    void appendSearchMatches(const QVector<SearchMatch>&);
+    void clearSearchMatches();
+    int searchMatchCount() const;
+    bool findNext(bool backward = false);
+    UndoHistory* undoHistory() const;
+    EditJournal* journal() const;
+    ContentHash* contentHash() const;
+    TextStats* textStats() const;
+    TextFormat textFormat() const;
+    void setTextFormat(const TextFormat&);
+    QString fileText() const;
+    void setDigitAtlas(bool);
+
+public slots:
+    void undoStep();
+
+signals:
+    void visibleBlocksChanged(int, int);
 
 protected:
     void resizeEvent(QResizeEvent* event) override;
+    void changeEvent(QEvent* event) override;
+    void keyPressEvent(QKeyEvent* event) override;
+    void contextMenuEvent(QContextMenuEvent* event) override;
+    void paintEvent(QPaintEvent* event) override;
+
+private:
+    void updateVisibleBlocks();
+    void updateDigitAtlas();
+    QPixmap digitAtlas;
+    QFont atlasFont;
+    qreal atlasRatio;
+    bool atlasEnabled;
+    int digitWidth;
+    int digitHeight;
+    int numberDigits;
+    int gutterWidth;
+    QVector<SearchMatch> searchMatches;
+    UndoHistory* history;
+    EditJournal* editJournal;
+    ContentHash* hash;
+    TextStats* stats;
+    TextFormat format;
+    int visibleFirst;
+    int visibleLast;
+    int changes;
 
 private slots:
     void changeLineNumberAreaWidth(int);
     void currLine();
     void changeLineNumberArea(const QRect&, int);
+    void countChange();
 };
 
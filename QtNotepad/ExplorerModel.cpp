@@ -0,0 +1,531 @@
+#include "ExplorerModel.h"
+#include "Trace.h"
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFile>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QSet>
+#include <algorithm>
+
+static const int batchSize = 2000;
+
+struct ExplorerNode
+{
+    QString name;
+    ExplorerNode* parent = nullptr;
+    QVector<ExplorerNode*> children;
+    QSharedPointer<const IgnoreRules> rules;
+    QVector<ExplorerEntry> incoming;
+    quint64 id = 0;
+    int row = 0;
+    int hidden = 0;
+    bool dir = false;
+    bool more = false;
+    bool fetched = false;
+    bool fetching = false;
+    bool stale = false;
+};
+
+struct ExplorerJob
+{
+    QMutex mutex;
+    ExplorerModel* model;
+};
+
+typedef QVector<QPair<QString, QSharedPointer<const IgnoreRules>>> RuleChain;
+
+static bool entryLess(const ExplorerEntry& a, const ExplorerEntry& b)
+{
+    if (a.dir != b.dir) return a.dir;
+    int order = QString::compare(a.name, b.name, Qt::CaseInsensitive);
+    return order ? order < 0 : a.name < b.name;
+}
+
+static QString entryKey(bool dir, const QString& name)
+{
+    return (dir ? QLatin1Char('d') : QLatin1Char('f')) + name;
+}
+
+static void deleteTree(ExplorerNode* node)
+{
+    for (ExplorerNode* child : qAsConst(node->children)) deleteTree(child);
+    delete node;
+}
+
+static QString globToRegex(const QString& glob)
+{
+    QString regex;
+    for (int i = 0; i < glob.size(); ++i)
+    {
+        QChar c = glob.at(i);
+        if (c == '*' && i + 1 < glob.size() && glob.at(i + 1) == '*')
+        {
+            ++i;
+            if (i + 1 < glob.size() && glob.at(i + 1) == '/')
+            {
+                ++i;
+                regex += "(?:.*/)?";
+            }
+            else regex += ".*";
+        }
+        else if (c == '*') regex += "[^/]*";
+        else if (c == '?') regex += "[^/]";
+        else if (c == '[' && glob.indexOf(']', i + 1) > i + 1)
+        {
+            int end = glob.indexOf(']', i + 1);
+            QString set = glob.mid(i + 1, end - i - 1);
+            if (set.startsWith('!')) set[0] = '^';
+            regex += '[' + set.replace("\\", "\\\\") + ']';
+            i = end;
+        }
+        else if (c == '\\' && i + 1 < glob.size()) regex += QRegularExpression::escape(QString(glob.at(++i)));
+        else regex += QRegularExpression::escape(QString(c));
+    }
+    return regex;
+}
+
+void IgnoreRules::add(const QString& line)
+{
+    QString pattern = line;
+    while (pattern.endsWith(' ') && !pattern.endsWith("\\ ")) pattern.chop(1);
+    if (pattern.isEmpty() || pattern.startsWith('#')) return;
+
+    Rule rule;
+    rule.negate = pattern.startsWith('!');
+    if (rule.negate) pattern.remove(0, 1);
+    rule.dirOnly = pattern.endsWith('/');
+    if (rule.dirOnly) pattern.chop(1);
+    rule.anchored = pattern.contains('/');
+    if (pattern.startsWith('/')) pattern.remove(0, 1);
+    if (pattern.isEmpty()) return;
+
+    rule.pattern = QRegularExpression(QRegularExpression::anchoredPattern(globToRegex(pattern)));
+    if (!rule.pattern.isValid()) return;
+    rule.pattern.optimize();
+    rules.append(rule);
+}
+
+void IgnoreRules::load(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) return;
+    while (!file.atEnd()) add(QString::fromUtf8(file.readLine()).remove('\n').remove('\r'));
+}
+
+int IgnoreRules::match(const QString& relative, bool dir) const
+{
+    int result = -1;
+    QString name = relative.section('/', -1);
+    for (const Rule& rule : rules)
+    {
+        if (rule.dirOnly && !dir) continue;
+        if (rule.pattern.match(rule.anchored ? relative : name).hasMatch()) result = rule.negate ? 0 : 1;
+    }
+    return result;
+}
+
+bool IgnoreRules::isEmpty() const
+{
+    return rules.isEmpty();
+}
+
+ExplorerModel::ExplorerModel(QObject* parent) : QAbstractItemModel(parent),
+    job(new ExplorerJob), globalRules(new IgnoreRules), nextId(1), maxEntries(20000), maxWatches(256)
+{
+    job->model = this;
+    watcher = new QFileSystemWatcher(this);
+    connect(watcher, SIGNAL(directoryChanged(QString)), SLOT(directoryChanged(QString)));
+    rootNode = new ExplorerNode;
+    rootNode->dir = true;
+    rootNode->fetched = true;
+}
+
+ExplorerModel::~ExplorerModel()
+{
+    {
+        QMutexLocker locker(&job->mutex);
+        job->model = nullptr;
+    }
+    deleteTree(rootNode);
+}
+
+void ExplorerModel::setRootPath(const QString& path)
+{
+    beginResetModel();
+    deleteTree(rootNode);
+    pending.clear();
+    if (!watchOrder.isEmpty()) watcher->removePaths(watchOrder);
+    watched.clear();
+    watchOrder.clear();
+    rootNode = new ExplorerNode;
+    rootNode->name = QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+    rootNode->dir = true;
+    endResetModel();
+    enumerate(rootNode);
+}
+
+QString ExplorerModel::rootPath() const
+{
+    return rootNode->name;
+}
+
+void ExplorerModel::setIgnorePatterns(const QStringList& patterns)
+{
+    QSharedPointer<IgnoreRules> rules(new IgnoreRules);
+    for (const QString& pattern : patterns) rules->add(pattern);
+    globalRules = rules;
+}
+
+void ExplorerModel::setLimits(int entries, int watches)
+{
+    maxEntries = qMax(1, entries);
+    maxWatches = qMax(0, watches);
+}
+
+ExplorerNode* ExplorerModel::node(const QModelIndex& index) const
+{
+    return index.isValid() ? static_cast<ExplorerNode*>(index.internalPointer()) : rootNode;
+}
+
+QModelIndex ExplorerModel::indexOf(ExplorerNode* target) const
+{
+    return target == rootNode ? QModelIndex() : createIndex(target->row, 0, target);
+}
+
+QString ExplorerModel::pathOf(const ExplorerNode* target) const
+{
+    QStringList names;
+    for (; target->parent; target = target->parent) names.prepend(target->name);
+    QString path = target->name;
+    for (const QString& name : qAsConst(names))
+    {
+        if (!path.endsWith('/')) path += '/';
+        path += name;
+    }
+    return path;
+}
+
+QString ExplorerModel::filePath(const QModelIndex& index) const
+{
+    if (!index.isValid() || node(index)->more) return QString();
+    return pathOf(node(index));
+}
+
+bool ExplorerModel::isDir(const QModelIndex& index) const
+{
+    return index.isValid() && node(index)->dir;
+}
+
+QModelIndex ExplorerModel::index(int row, int column, const QModelIndex& parent) const
+{
+    ExplorerNode* target = node(parent);
+    if (column != 0 || row < 0 || row >= target->children.size()) return QModelIndex();
+    return createIndex(row, 0, target->children.at(row));
+}
+
+QModelIndex ExplorerModel::parent(const QModelIndex& child) const
+{
+    if (!child.isValid()) return QModelIndex();
+    return indexOf(node(child)->parent);
+}
+
+int ExplorerModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.column() > 0) return 0;
+    return node(parent)->children.size();
+}
+
+int ExplorerModel::columnCount(const QModelIndex&) const
+{
+    return 1;
+}
+
+QVariant ExplorerModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid()) return QVariant();
+    ExplorerNode* target = node(index);
+    if (role == Qt::DisplayRole) return target->name;
+    if (target->more) return QVariant();
+    if (role == Qt::DecorationRole) return icons.icon(target->dir ? QFileIconProvider::Folder : QFileIconProvider::File);
+    if (role == Qt::ToolTipRole) return pathOf(target);
+    return QVariant();
+}
+
+bool ExplorerModel::hasChildren(const QModelIndex& parent) const
+{
+    ExplorerNode* target = node(parent);
+    if (!target->dir) return false;
+    return !target->fetched || !target->children.isEmpty();
+}
+
+bool ExplorerModel::canFetchMore(const QModelIndex& parent) const
+{
+    ExplorerNode* target = node(parent);
+    return target->dir && !target->fetched && !target->fetching;
+}
+
+void ExplorerModel::fetchMore(const QModelIndex& parent)
+{
+    enumerate(node(parent));
+}
+
+void ExplorerModel::release(const QModelIndex& index)
+{
+    if (!index.isValid() || !node(index)->dir) return;
+    clearChildren(node(index));
+}
+
+void ExplorerModel::enumerate(ExplorerNode* target)
+{
+    if (!target->dir || target->fetching || target->name.isEmpty()) return;
+    pending.remove(target->id);
+    target->id = nextId++;
+    target->fetching = true;
+    target->incoming.clear();
+    pending.insert(target->id, target);
+
+    RuleChain chain;
+    chain.append(qMakePair(rootNode->name, globalRules));
+    QVector<ExplorerNode*> ancestors;
+    for (ExplorerNode* ancestor = target->parent; ancestor; ancestor = ancestor->parent) ancestors.prepend(ancestor);
+    for (ExplorerNode* ancestor : qAsConst(ancestors))
+    {
+        if (ancestor->rules) chain.append(qMakePair(pathOf(ancestor), ancestor->rules));
+    }
+
+    QString path = pathOf(target);
+    quint64 id = target->id;
+    int limit = maxEntries;
+    QSharedPointer<ExplorerJob> shared = job;
+    QThreadPool::globalInstance()->start([shared, path, id, limit, chain]() mutable
+    {
+        TRACE_SCOPE("ExplorerModel::enumerate");
+        QSharedPointer<IgnoreRules> local(new IgnoreRules);
+        local->load(path + "/.gitignore");
+        QSharedPointer<const IgnoreRules> found;
+        if (!local->isEmpty())
+        {
+            found = local;
+            chain.append(qMakePair(path, found));
+        }
+
+        QVector<ExplorerEntry> entries;
+        int hidden = 0;
+        QDirIterator iter(path, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
+        while (iter.hasNext())
+        {
+            iter.next();
+            ExplorerEntry entry;
+            entry.name = iter.fileName();
+            entry.dir = iter.fileInfo().isDir();
+            QString full = iter.filePath();
+            int ignored = -1;
+            for (const auto& rules : qAsConst(chain))
+            {
+                QString relative = full.mid(rules.first.size() + (rules.first.endsWith('/') ? 0 : 1));
+                int verdict = rules.second->match(relative, entry.dir);
+                if (verdict != -1) ignored = verdict;
+            }
+            if (ignored == 1) continue;
+            if (entries.size() < limit) entries.append(entry);
+            else ++hidden;
+        }
+        std::sort(entries.begin(), entries.end(), entryLess);
+
+        for (int start = 0;; start += batchSize)
+        {
+            QVector<ExplorerEntry> batch = entries.mid(start, batchSize);
+            bool last = start + batchSize >= entries.size();
+            QMutexLocker locker(&shared->mutex);
+            ExplorerModel* model = shared->model;
+            if (!model) return;
+            QMetaObject::invokeMethod(model, [model, id, batch, last, hidden, found]()
+            {
+                model->receive(id, batch, last, hidden, found);
+            }, Qt::QueuedConnection);
+            if (last) break;
+        }
+    });
+}
+
+void ExplorerModel::receive(quint64 id, const QVector<ExplorerEntry>& batch, bool last, int hidden, QSharedPointer<const IgnoreRules> rules)
+{
+    ExplorerNode* target = pending.value(id);
+    if (!target) return;
+
+    if (target->fetched)
+    {
+        target->incoming += batch;
+        if (!last) return;
+        merge(target, target->incoming);
+        target->incoming.clear();
+    }
+    else if (!batch.isEmpty())
+    {
+        int first = target->children.size();
+        beginInsertRows(indexOf(target), first, first + batch.size() - 1);
+        for (const ExplorerEntry& entry : batch)
+        {
+            ExplorerNode* child = new ExplorerNode;
+            child->name = entry.name;
+            child->dir = entry.dir;
+            child->parent = target;
+            child->row = target->children.size();
+            target->children.append(child);
+        }
+        endInsertRows();
+    }
+    if (!last) return;
+
+    pending.remove(id);
+    target->rules = rules;
+    target->fetching = false;
+    target->fetched = true;
+    setHidden(target, hidden);
+    watch(target);
+    if (target->stale)
+    {
+        target->stale = false;
+        enumerate(target);
+    }
+}
+
+void ExplorerModel::merge(ExplorerNode* target, const QVector<ExplorerEntry>& entries)
+{
+    setHidden(target, 0);
+    QModelIndex parent = indexOf(target);
+    QSet<QString> keys;
+    for (const ExplorerEntry& entry : entries) keys.insert(entryKey(entry.dir, entry.name));
+
+    for (int i = target->children.size() - 1; i >= 0; --i)
+    {
+        ExplorerNode* child = target->children.at(i);
+        if (keys.contains(entryKey(child->dir, child->name))) continue;
+        beginRemoveRows(parent, i, i);
+        forget(child);
+        target->children.remove(i);
+        renumber(target, i);
+        endRemoveRows();
+    }
+
+    int i = 0;
+    for (const ExplorerEntry& entry : entries)
+    {
+        if (i < target->children.size() && target->children.at(i)->name == entry.name && target->children.at(i)->dir == entry.dir)
+        {
+            ++i;
+            continue;
+        }
+        ExplorerNode* child = new ExplorerNode;
+        child->name = entry.name;
+        child->dir = entry.dir;
+        child->parent = target;
+        beginInsertRows(parent, i, i);
+        target->children.insert(i, child);
+        renumber(target, i);
+        endInsertRows();
+        ++i;
+    }
+}
+
+void ExplorerModel::setHidden(ExplorerNode* target, int hidden)
+{
+    QModelIndex parent = indexOf(target);
+    if (!target->children.isEmpty() && target->children.last()->more)
+    {
+        int row = target->children.size() - 1;
+        beginRemoveRows(parent, row, row);
+        delete target->children.takeLast();
+        endRemoveRows();
+    }
+    target->hidden = hidden;
+    if (hidden <= 0) return;
+
+    ExplorerNode* marker = new ExplorerNode;
+    marker->name = tr("%n more items not shown", "", hidden);
+    marker->more = true;
+    marker->parent = target;
+    marker->row = target->children.size();
+    beginInsertRows(parent, marker->row, marker->row);
+    target->children.append(marker);
+    endInsertRows();
+}
+
+void ExplorerModel::renumber(ExplorerNode* target, int from)
+{
+    for (int i = from; i < target->children.size(); ++i) target->children.at(i)->row = i;
+}
+
+void ExplorerModel::watch(ExplorerNode* target)
+{
+    if (maxWatches <= 0) return;
+    QString path = pathOf(target);
+    if (watched.contains(path))
+    {
+        watchOrder.removeOne(path);
+        watchOrder.append(path);
+        return;
+    }
+    if (!watcher->addPath(path)) return;
+    watched.insert(path, target);
+    watchOrder.append(path);
+    while (watchOrder.size() > maxWatches)
+    {
+        QString oldest = watchOrder.takeFirst();
+        watcher->removePath(oldest);
+        watched.remove(oldest);
+    }
+}
+
+void ExplorerModel::forget(ExplorerNode* target)
+{
+    for (ExplorerNode* child : qAsConst(target->children)) forget(child);
+    target->children.clear();
+    pending.remove(target->id);
+    if (target->dir && (target->fetched || target->fetching))
+    {
+        QString path = pathOf(target);
+        if (watched.value(path) == target)
+        {
+            watcher->removePath(path);
+            watched.remove(path);
+            watchOrder.removeOne(path);
+        }
+    }
+    delete target;
+}
+
+void ExplorerModel::clearChildren(ExplorerNode* target)
+{
+    if (!target->children.isEmpty())
+    {
+        beginRemoveRows(indexOf(target), 0, target->children.size() - 1);
+        for (ExplorerNode* child : qAsConst(target->children)) forget(child);
+        target->children.clear();
+        endRemoveRows();
+    }
+    pending.remove(target->id);
+    QString path = pathOf(target);
+    if (watched.value(path) == target)
+    {
+        watcher->removePath(path);
+        watched.remove(path);
+        watchOrder.removeOne(path);
+    }
+    target->incoming.clear();
+    target->hidden = 0;
+    target->fetched = false;
+    target->fetching = false;
+    target->stale = false;
+}
+
+void ExplorerModel::directoryChanged(const QString& path)
+{
+    ExplorerNode* target = watched.value(path);
+    if (!target) return;
+    if (target->fetching) target->stale = true;
+    else enumerate(target);
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <QAbstractItemModel>
+#include <QFileSystemWatcher>
+#include <QFileIconProvider>
+#include <QRegularExpression>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+
+class IgnoreRules
+{
+public:
+    void add(const QString&);
+    void load(const QString&);
+    int match(const QString&, bool) const;
+    bool isEmpty() const;
+
+private:
+    struct Rule
+    {
+        QRegularExpression pattern;
+        bool negate;
+        bool dirOnly;
+        bool anchored;
+    };
+    QVector<Rule> rules;
+};
+
+struct ExplorerEntry
+{
+    QString name;
+    bool dir;
+};
+
+struct ExplorerNode;
+struct ExplorerJob;
+
+class ExplorerModel : public QAbstractItemModel
+{
+    Q_OBJECT
+public:
+    explicit ExplorerModel(QObject* parent = nullptr);
+    ~ExplorerModel();
+
+    void setRootPath(const QString&);
+    QString rootPath() const;
+    void setIgnorePatterns(const QStringList&);
+    void setLimits(int, int);
+    QString filePath(const QModelIndex&) const;
+    bool isDir(const QModelIndex&) const;
+    void release(const QModelIndex&);
+
+    QModelIndex index(int, int, const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex&) const override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex&, int role = Qt::DisplayRole) const override;
+    bool hasChildren(const QModelIndex& parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex&) const override;
+    void fetchMore(const QModelIndex&) override;
+
+private slots:
+    void directoryChanged(const QString&);
+
+private:
+    ExplorerNode* node(const QModelIndex&) const;
+    QModelIndex indexOf(ExplorerNode*) const;
+    QString pathOf(const ExplorerNode*) const;
+    void enumerate(ExplorerNode*);
+    void receive(quint64, const QVector<ExplorerEntry>&, bool, int, QSharedPointer<const IgnoreRules>);
+    void merge(ExplorerNode*, const QVector<ExplorerEntry>&);
+    void setHidden(ExplorerNode*, int);
+    void renumber(ExplorerNode*, int);
+    void watch(ExplorerNode*);
+    void forget(ExplorerNode*);
+    void clearChildren(ExplorerNode*);
+
+    ExplorerNode* rootNode;
+    QSharedPointer<ExplorerJob> job;
+    QFileSystemWatcher* watcher;
+    QHash<quint64, ExplorerNode*> pending;
+    QHash<QString, ExplorerNode*> watched;
+    QStringList watchOrder;
+    QSharedPointer<const IgnoreRules> globalRules;
+    QFileIconProvider icons;
+    quint64 nextId;
+    int maxEntries;
+    int maxWatches;
+};
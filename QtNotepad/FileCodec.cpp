@@ -0,0 +1,251 @@
+#include "FileCodec.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtAlgorithms>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FILECODEC_SSE2
+#endif
+
+static const qsizetype sampleSize = 64 * 1024;
+
+static QMutex legacyMutex;
+static QByteArray legacyEncoding = "ISO-8859-1";
+
+QString TextFormat::name() const
+{
+    return QString::fromLatin1(encoding) + (bom ? " BOM" : "") + (crlf ? " CRLF" : " LF");
+}
+
+static qsizetype asciiPrefix(const char* data, qsizetype size)
+{
+    qsizetype i = 0;
+#ifdef FILECODEC_SSE2
+    for (; i + 16 <= size; i += 16)
+    {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+        if (mask) return i + qCountTrailingZeroBits(uint(mask));
+    }
+#endif
+    while (i < size && !(uchar(data[i]) & 0x80)) ++i;
+    return i;
+}
+
+static QString widenAscii(const char* data, qsizetype size)
+{
+    QString text(size, Qt::Uninitialized);
+    char16_t* out = reinterpret_cast<char16_t*>(text.data());
+    qsizetype i = 0;
+#ifdef FILECODEC_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi8(chunk, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpackhi_epi8(chunk, zero));
+    }
+#endif
+    for (; i < size; ++i) out[i] = uchar(data[i]);
+    return text;
+}
+
+bool FileCodec::isAscii(const char* data, qsizetype size)
+{
+    qsizetype i = 0;
+#ifdef FILECODEC_SSE2
+    for (; i + 64 <= size; i += 64)
+    {
+        const __m128i* block = reinterpret_cast<const __m128i*>(data + i);
+        __m128i bits = _mm_or_si128(_mm_or_si128(_mm_loadu_si128(block), _mm_loadu_si128(block + 1)),
+            _mm_or_si128(_mm_loadu_si128(block + 2), _mm_loadu_si128(block + 3)));
+        if (_mm_movemask_epi8(bits)) return false;
+    }
+#endif
+    return asciiPrefix(data + i, size - i) == size - i;
+}
+
+bool FileCodec::isUtf8(const char* data, qsizetype size)
+{
+    const uchar* bytes = reinterpret_cast<const uchar*>(data);
+    qsizetype i = 0;
+    while (i < size)
+    {
+        i += asciiPrefix(data + i, size - i);
+        if (i >= size) break;
+
+        uchar lead = bytes[i];
+        int length = 0;
+        uint code = 0;
+        if (lead >= 0xC2 && lead <= 0xDF)
+        {
+            length = 2;
+            code = lead & 0x1F;
+        }
+        else if ((lead & 0xF0) == 0xE0)
+        {
+            length = 3;
+            code = lead & 0x0F;
+        }
+        else if (lead >= 0xF0 && lead <= 0xF4)
+        {
+            length = 4;
+            code = lead & 0x07;
+        }
+        else return false;
+        if (size - i < length) return false;
+
+        for (int k = 1; k < length; ++k)
+        {
+            uchar next = bytes[i + k];
+            if ((next & 0xC0) != 0x80) return false;
+            code = (code << 6) | (next & 0x3F);
+        }
+        if (length == 3 && (code < 0x800 || (code >= 0xD800 && code <= 0xDFFF))) return false;
+        if (length == 4 && (code < 0x10000 || code > 0x10FFFF)) return false;
+        i += length;
+    }
+    return true;
+}
+
+void FileCodec::setLegacyEncoding(const QByteArray& name)
+{
+    QMutexLocker locker(&legacyMutex);
+    legacyEncoding = name.isEmpty() ? QByteArray("ISO-8859-1") : name;
+}
+
+TextFormat FileCodec::detect(QByteArrayView data)
+{
+    TextFormat format;
+    const uchar* bytes = reinterpret_cast<const uchar*>(data.data());
+    const qsizetype size = data.size();
+    qsizetype start = 0;
+    int unit = 1;
+    bool bigEndian = false;
+
+    if (size >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF)
+    {
+        format.bom = true;
+        start = 3;
+    }
+    else if (size >= 2 && ((bytes[0] == 0xFF && bytes[1] == 0xFE) || (bytes[0] == 0xFE && bytes[1] == 0xFF)))
+    {
+        bigEndian = bytes[0] == 0xFE;
+        format.encoding = bigEndian ? "UTF-16BE" : "UTF-16LE";
+        format.bom = true;
+        start = 2;
+        unit = 2;
+    }
+    else
+    {
+        // Without a BOM, UTF-16 shows up as one zero byte in almost every pair of mostly Latin text.
+        qsizetype units = qMin(size, sampleSize) / 2;
+        qsizetype evenZeros = 0;
+        qsizetype oddZeros = 0;
+        for (qsizetype i = 0; i < units; ++i)
+        {
+            if (!bytes[2 * i]) ++evenZeros;
+            if (!bytes[2 * i + 1]) ++oddZeros;
+        }
+        if (units >= 2 && oddZeros > units * 3 / 10 && evenZeros < units / 20) unit = 2;
+        else if (units >= 2 && evenZeros > units * 3 / 10 && oddZeros < units / 20)
+        {
+            unit = 2;
+            bigEndian = true;
+        }
+        if (unit == 2) format.encoding = bigEndian ? "UTF-16BE" : "UTF-16LE";
+        else if (!isUtf8(data.data(), size))
+        {
+            QMutexLocker locker(&legacyMutex);
+            format.encoding = legacyEncoding;
+        }
+    }
+
+    if (unit == 1)
+    {
+        const void* found = size > start ? std::memchr(bytes + start, '\n', size - start) : nullptr;
+        if (found) format.crlf = found != bytes + start && static_cast<const uchar*>(found)[-1] == '\r';
+        return format;
+    }
+    uint previous = 0;
+    for (qsizetype i = start; i + 1 < size; i += 2)
+    {
+        uint code = bigEndian ? (bytes[i] << 8 | bytes[i + 1]) : (bytes[i + 1] << 8 | bytes[i]);
+        if (code == '\n')
+        {
+            format.crlf = previous == '\r';
+            break;
+        }
+        previous = code;
+    }
+    return format;
+}
+
+QString FileCodec::decodeAll(QByteArrayView data, TextFormat* format)
+{
+    FileCodec codec(detect(data));
+    QString text = codec.decode(data);
+    text += codec.flush();
+    if (format) *format = codec.format();
+    return text;
+}
+
+FileCodec::FileCodec(const TextFormat& format) : textFormat(format), utf8(false), pendingCr(false), started(false)
+{
+    decoder = QStringDecoder(textFormat.encoding.constData(), QStringConverter::Flag::ConvertInitialBom);
+    if (!decoder.isValid())
+    {
+        textFormat.encoding = "ISO-8859-1";
+        decoder = QStringDecoder(QStringConverter::Latin1, QStringConverter::Flag::ConvertInitialBom);
+    }
+    encoder = QStringEncoder(textFormat.encoding.constData(),
+        textFormat.bom ? QStringConverter::Flag::WriteBom : QStringConverter::Flag::Default);
+    utf8 = textFormat.encoding == "UTF-8";
+}
+
+const TextFormat& FileCodec::format() const
+{
+    return textFormat;
+}
+
+QString FileCodec::decode(QByteArrayView bytes)
+{
+    if (!started)
+    {
+        started = true;
+        if (textFormat.bom) bytes = bytes.sliced(qMin<qsizetype>(bytes.size(), utf8 ? 3 : 2));
+    }
+
+    // Pure ASCII chunks of a validated UTF-8 file can't leave the decoder mid-sequence, so they skip it.
+    QString text;
+    if (utf8 && isAscii(bytes.data(), bytes.size())) text = widenAscii(bytes.data(), bytes.size());
+    else text = decoder.decode(bytes);
+    if (!textFormat.crlf) return text;
+
+    if (pendingCr) text.prepend(QLatin1Char('\r'));
+    pendingCr = text.endsWith(QLatin1Char('\r'));
+    if (pendingCr) text.chop(1);
+    text.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+    return text;
+}
+
+QString FileCodec::flush()
+{
+    QString rest = pendingCr ? QString(QLatin1Char('\r')) : QString();
+    pendingCr = false;
+    return rest;
+}
+
+QByteArray FileCodec::encode(QStringView text)
+{
+    if (!textFormat.crlf) return encoder.encode(text);
+    QString expanded = text.toString();
+    expanded.replace(QLatin1Char('\n'), QLatin1String("\r\n"));
+    return encoder.encode(expanded);
+}
+
+bool FileCodec::hasError() const
+{
+    return decoder.hasError() || encoder.hasError();
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <QString>
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QStringView>
+#include <QStringDecoder>
+#include <QStringEncoder>
+
+struct TextFormat
+{
+    QByteArray encoding = "UTF-8";
+    bool bom = false;
+    bool crlf = false;
+
+    QString name() const;
+    bool operator==(const TextFormat& other) const
+    {
+        return encoding == other.encoding && bom == other.bom && crlf == other.crlf;
+    }
+};
+
+class FileCodec
+{
+public:
+    explicit FileCodec(const TextFormat& format = TextFormat());
+
+    static void setLegacyEncoding(const QByteArray&);
+    static TextFormat detect(QByteArrayView);
+    static QString decodeAll(QByteArrayView, TextFormat* format = nullptr);
+    static bool isAscii(const char*, qsizetype);
+    static bool isUtf8(const char*, qsizetype);
+
+    const TextFormat& format() const;
+    QString decode(QByteArrayView);
+    QString flush();
+    QByteArray encode(QStringView);
+    bool hasError() const;
+
+private:
+    TextFormat textFormat;
+    QStringDecoder decoder;
+    QStringEncoder encoder;
+    bool utf8;
+    bool pendingCr;
+    bool started;
+};
@@ -0,0 +1,625 @@
+#include "FileIndex.h"
+#include "Trace.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAtomicInt>
+#include <QPair>
+#include <algorithm>
+#include <functional>
+
+static const int spawnDepth = 2;
+static const int queryChunk = 65536;
+static const quint32 cacheMagic = 0x51464958;
+static const qint32 cacheVersion = 1;
+static const QDir::Filters scanFilters = QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System | QDir::NoSymLinks;
+
+struct FileIndexJob
+{
+    QMutex mutex;
+    FileIndex* index;
+    QAtomicInt generation;
+    QAtomicInt queryGeneration;
+};
+
+struct FileIndexBuild
+{
+    QSharedPointer<FileIndexJob> job;
+    QThreadPool* pool;
+    QString root;
+    QSharedPointer<const IgnoreRules> rules;
+    std::function<void(FileIndex*, const FileIndexData&)> done;
+    int generation;
+    QAtomicInt pending;
+    QMutex mutex;
+    QVector<QByteArray> files;
+    QVector<QByteArray> dirs;
+
+    bool canceled() const { return job->generation.loadRelaxed() != generation; }
+};
+
+typedef QPair<int, int> Ranked;
+
+struct FileIndexQuery
+{
+    QSharedPointer<FileIndexJob> job;
+    QString text;
+    QString root;
+    QByteArray needle;
+    quint64 mask;
+    QVector<QByteArray> entries;
+    QVector<quint64> masks;
+    int limit;
+    int generation;
+    QAtomicInt pending;
+    QMutex mutex;
+    QVector<Ranked> best;
+
+    bool canceled() const { return job->queryGeneration.loadRelaxed() != generation; }
+};
+
+static inline char fold(char c)
+{
+    return c >= 'A' && c <= 'Z' ? char(c + 32) : c;
+}
+
+static inline bool boundary(char c)
+{
+    return c == '/' || c == '_' || c == '-' || c == '.' || c == ' ';
+}
+
+static inline bool better(const Ranked& a, const Ranked& b)
+{
+    return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+static QString absolute(const QString& root, const QByteArray& relative)
+{
+    if (relative.isEmpty()) return root;
+    return root.endsWith('/') ? root + QString::fromUtf8(relative) : root + '/' + QString::fromUtf8(relative);
+}
+
+static QByteArray parentOf(const QByteArray& path)
+{
+    int slash = path.lastIndexOf('/');
+    return slash < 0 ? QByteArray() : path.left(slash);
+}
+
+static FileIndexData makeData(const QVector<QByteArray>& files, const QVector<QByteArray>& dirList)
+{
+    FileIndexData data;
+    data.entries = files;
+    data.masks.resize(files.size());
+    for (const QByteArray& dir : dirList) data.dirs.insert(dir, QVector<int>());
+    for (int i = 0; i < files.size(); ++i)
+    {
+        data.masks[i] = FileIndex::charMask(files.at(i));
+        data.dirs[parentOf(files.at(i))].append(i);
+    }
+    return data;
+}
+
+static void deliver(const QSharedPointer<FileIndexJob>& job, int generation, const std::function<void(FileIndex*)>& call)
+{
+    QMutexLocker locker(&job->mutex);
+    FileIndex* index = job->index;
+    if (!index) return;
+    QMetaObject::invokeMethod(index, [job, index, generation, call]()
+    {
+        if (job->generation.loadRelaxed() == generation) call(index);
+    }, Qt::QueuedConnection);
+}
+
+static void scanTree(const QSharedPointer<FileIndexBuild>& build, const QString& relative, int depth)
+{
+    TRACE_SCOPE("FileIndex::scan");
+    QVector<QByteArray> files;
+    QVector<QByteArray> dirs;
+    QStringList stack{ relative };
+    while (!stack.isEmpty() && !build->canceled())
+    {
+        QString dir = stack.takeLast();
+        dirs.append(dir.toUtf8());
+        QDirIterator iter(absolute(build->root, dirs.last()), scanFilters);
+        while (iter.hasNext())
+        {
+            iter.next();
+            QString path = dir.isEmpty() ? iter.fileName() : dir + '/' + iter.fileName();
+            bool isDir = iter.fileInfo().isDir();
+            if (build->rules->match(path, isDir) == 1) continue;
+            if (!isDir) files.append(path.toUtf8());
+            else if (depth < spawnDepth)
+            {
+                build->pending.ref();
+                build->pool->start([build, path, depth]() { scanTree(build, path, depth + 1); });
+            }
+            else stack.append(path);
+        }
+    }
+
+    {
+        QMutexLocker locker(&build->mutex);
+        build->files += files;
+        build->dirs += dirs;
+    }
+    if (build->pending.deref() || build->canceled()) return;
+    FileIndexData data = makeData(build->files, build->dirs);
+    std::function<void(FileIndex*, const FileIndexData&)> done = build->done;
+    deliver(build->job, build->generation, [done, data](FileIndex* index) { done(index, data); });
+}
+
+static void matchChunk(const QSharedPointer<FileIndexQuery>& run, int begin, int end)
+{
+    TRACE_SCOPE("FileIndex::match");
+    QVector<Ranked> best;
+    const quint64 mask = run->mask;
+    const quint64* masks = run->masks.constData();
+    for (int i = begin; i < end; ++i)
+    {
+        if ((i & 4095) == 0 && run->canceled()) return;
+        if ((masks[i] & mask) != mask) continue;
+        int value = FileIndex::score(run->entries.at(i), run->needle);
+        if (value < 0) continue;
+        Ranked item(value, i);
+        if (best.size() < run->limit)
+        {
+            best.append(item);
+            std::push_heap(best.begin(), best.end(), better);
+        }
+        else if (better(item, best.front()))
+        {
+            std::pop_heap(best.begin(), best.end(), better);
+            best.last() = item;
+            std::push_heap(best.begin(), best.end(), better);
+        }
+    }
+
+    QStringList paths;
+    {
+        QMutexLocker locker(&run->mutex);
+        run->best += best;
+        if (run->pending.deref()) return;
+        std::sort(run->best.begin(), run->best.end(), better);
+        if (run->best.size() > run->limit) run->best.resize(run->limit);
+        for (const Ranked& item : qAsConst(run->best)) paths.append(absolute(run->root, run->entries.at(item.second)));
+    }
+
+    QMutexLocker locker(&run->job->mutex);
+    FileIndex* index = run->job->index;
+    if (!index) return;
+    QSharedPointer<FileIndexJob> job = run->job;
+    int generation = run->generation;
+    QString text = run->text;
+    QMetaObject::invokeMethod(index, [job, index, generation, text, paths]()
+    {
+        if (job->queryGeneration.loadRelaxed() == generation) emit index->results(text, paths);
+    }, Qt::QueuedConnection);
+}
+
+static bool window(const char* s, int from, int n, const char* q, int m, int& start, int& end)
+{
+    int j = 0;
+    end = -1;
+    for (int i = from; i < n; ++i)
+    {
+        if (fold(s[i]) == q[j] && ++j == m)
+        {
+            end = i;
+            break;
+        }
+    }
+    if (end < 0) return false;
+
+    j = m - 1;
+    start = end;
+    for (int i = end; i >= from; --i)
+    {
+        if (fold(s[i]) == q[j] && j-- == 0)
+        {
+            start = i;
+            break;
+        }
+    }
+    return true;
+}
+
+quint64 FileIndex::charMask(const QByteArray& text)
+{
+    quint64 mask = 0;
+    for (char c : text)
+    {
+        uchar u = uchar(fold(c));
+        if (u >= 'a' && u <= 'z') mask |= quint64(1) << (u - 'a');
+        else if (u >= '0' && u <= '9') mask |= quint64(1) << (26 + u - '0');
+        else mask |= quint64(1) << (36 + u % 28);
+    }
+    return mask;
+}
+
+int FileIndex::score(const QByteArray& path, const QByteArray& needle)
+{
+    const char* s = path.constData();
+    const char* q = needle.constData();
+    int n = path.size();
+    int m = needle.size();
+    if (m == 0) return 0;
+    if (m > n) return -1;
+
+    int base = path.lastIndexOf('/') + 1;
+    int start = 0;
+    int end = 0;
+    int result = 0;
+    if (window(s, base, n, q, m, start, end)) result += 64;
+    else if (!window(s, 0, n, q, m, start, end)) return -1;
+
+    int previous = -2;
+    for (int i = start, j = 0; i <= end && j < m; ++i)
+    {
+        if (fold(s[i]) != q[j]) continue;
+        int bonus = 16;
+        if (i == 0 || boundary(s[i - 1])) bonus += 24;
+        else if (s[i] >= 'A' && s[i] <= 'Z' && s[i - 1] >= 'a' && s[i - 1] <= 'z') bonus += 16;
+        if (previous == i - 1) bonus += 20;
+        result += bonus;
+        previous = i;
+        ++j;
+    }
+    if (start == base) result += 32;
+    return qMax(0, result - (end - start + 1 - m) - n / 8);
+}
+
+FileIndex::FileIndex(QObject* parent) : QObject(parent), job(new FileIndexJob), rules(new IgnoreRules),
+    count(0), maxWatches(1024), cache(true), building(false)
+{
+    job->index = this;
+    watcher = new QFileSystemWatcher(this);
+    connect(watcher, SIGNAL(directoryChanged(QString)), SLOT(directoryChanged(QString)));
+    rescanTimer = new QTimer(this);
+    rescanTimer->setSingleShot(true);
+    rescanTimer->setInterval(300);
+    connect(rescanTimer, SIGNAL(timeout()), SLOT(rescanChanged()));
+    cacheTimer = new QTimer(this);
+    cacheTimer->setSingleShot(true);
+    cacheTimer->setInterval(5000);
+    connect(cacheTimer, SIGNAL(timeout()), SLOT(writeCache()));
+}
+
+FileIndex::~FileIndex()
+{
+    job->generation.fetchAndAddRelaxed(1);
+    job->queryGeneration.fetchAndAddRelaxed(1);
+    {
+        QMutexLocker locker(&job->mutex);
+        job->index = nullptr;
+    }
+    if (cacheTimer->isActive()) writeCache();
+    queryPool.waitForDone();
+    pool.waitForDone();
+}
+
+void FileIndex::setRoot(const QString& path)
+{
+    int generation = job->generation.fetchAndAddRelaxed(1) + 1;
+    rootPath = QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+    QSharedPointer<IgnoreRules> ignore(new IgnoreRules);
+    for (const QString& pattern : qAsConst(patterns)) ignore->add(pattern);
+    ignore->load(rootPath + "/.gitignore");
+    rules = ignore;
+
+    entries.clear();
+    masks.clear();
+    freeSlots.clear();
+    dirs.clear();
+    changed.clear();
+    count = 0;
+    if (!watcher->directories().isEmpty()) watcher->removePaths(watcher->directories());
+    rescanTimer->stop();
+    cacheTimer->stop();
+    building = true;
+
+    QSharedPointer<FileIndexJob> shared = job;
+    if (cache)
+    {
+        QString file = cachePath();
+        QString root = rootPath;
+        pool.start([shared, generation, file, root]()
+        {
+            TRACE_SCOPE("FileIndex::readCache");
+            QFile input(file);
+            if (!input.open(QIODevice::ReadOnly)) return;
+            QDataStream stream(&input);
+            quint32 magic = 0;
+            qint32 version = 0;
+            stream >> magic >> version;
+            if (magic != cacheMagic || version != cacheVersion) return;
+
+            QString cachedRoot;
+            QVector<QByteArray> files;
+            QVector<QByteArray> dirList;
+            stream >> cachedRoot >> files >> dirList;
+            if (stream.status() != QDataStream::Ok || cachedRoot != root) return;
+            FileIndexData data = makeData(files, dirList);
+            deliver(shared, generation, [data](FileIndex* index) { index->loaded(data, true); });
+        });
+    }
+
+    QSharedPointer<FileIndexBuild> build(new FileIndexBuild);
+    build->job = job;
+    build->pool = &pool;
+    build->root = rootPath;
+    build->rules = rules;
+    build->generation = generation;
+    build->pending.storeRelaxed(1);
+    build->done = [](FileIndex* index, const FileIndexData& data) { index->loaded(data, false); };
+    pool.start([build]() { scanTree(build, QString(), 0); });
+}
+
+QString FileIndex::root() const
+{
+    return rootPath;
+}
+
+void FileIndex::setIgnorePatterns(const QStringList& list)
+{
+    patterns = list;
+}
+
+void FileIndex::setMaxWatches(int watches)
+{
+    maxWatches = qMax(0, watches);
+}
+
+void FileIndex::setCacheEnabled(bool enabled)
+{
+    cache = enabled;
+}
+
+int FileIndex::size() const
+{
+    return count;
+}
+
+bool FileIndex::isBuilding() const
+{
+    return building;
+}
+
+void FileIndex::query(const QString& text, int limit)
+{
+    int generation = job->queryGeneration.fetchAndAddRelaxed(1) + 1;
+    QByteArray needle;
+    for (char c : text.toUtf8())
+    {
+        if (c != ' ') needle.append(fold(c));
+    }
+    if (needle.isEmpty())
+    {
+        emit results(text, QStringList());
+        return;
+    }
+
+    QSharedPointer<FileIndexQuery> run(new FileIndexQuery);
+    run->job = job;
+    run->text = text;
+    run->root = rootPath;
+    run->needle = needle;
+    run->mask = charMask(needle);
+    run->entries = entries;
+    run->masks = masks;
+    run->limit = qMax(1, limit);
+    run->generation = generation;
+    int chunks = qMax(1, int((entries.size() + queryChunk - 1) / queryChunk));
+    run->pending.storeRelaxed(chunks);
+    for (int chunk = 0; chunk < chunks; ++chunk)
+    {
+        int begin = chunk * queryChunk;
+        int end = qMin(int(entries.size()), begin + queryChunk);
+        queryPool.start([run, begin, end]() { matchChunk(run, begin, end); });
+    }
+}
+
+void FileIndex::loaded(const FileIndexData& data, bool cached)
+{
+    if (cached && !building) return;
+    entries = data.entries;
+    masks = data.masks;
+    dirs = data.dirs;
+    freeSlots.clear();
+    count = entries.size();
+    if (!cached)
+    {
+        building = false;
+        if (cache) cacheTimer->start();
+    }
+    if (!watcher->directories().isEmpty()) watcher->removePaths(watcher->directories());
+    watch(dirs.keys());
+    emit ready(count);
+}
+
+void FileIndex::merge(const FileIndexData& data)
+{
+    for (auto it = data.dirs.cbegin(); it != data.dirs.cend(); ++it)
+    {
+        QVector<int>& members = dirs[it.key()];
+        if (!members.isEmpty()) continue;
+        for (int i : it.value()) members.append(insert(data.entries.at(i)));
+    }
+    watch(data.dirs.keys());
+    if (cache) cacheTimer->start();
+}
+
+void FileIndex::updateDir(const QByteArray& dir, const QVector<QByteArray>& files, const QVector<QByteArray>& subdirs)
+{
+    QSet<QByteArray> present(files.begin(), files.end());
+    QVector<int> kept;
+    for (int slot : dirs.value(dir))
+    {
+        if (present.remove(entries.at(slot))) kept.append(slot);
+        else drop(slot);
+    }
+    for (const QByteArray& path : qAsConst(present)) kept.append(insert(path));
+    dirs.insert(dir, kept);
+
+    QSet<QByteArray> current(subdirs.begin(), subdirs.end());
+    QByteArray prefix = dir.isEmpty() ? QByteArray() : dir + '/';
+    QVector<QByteArray> gone;
+    for (auto it = dirs.cbegin(); it != dirs.cend(); ++it)
+    {
+        const QByteArray& key = it.key();
+        if (key.size() <= prefix.size() || !key.startsWith(prefix) || key.indexOf('/', prefix.size()) >= 0) continue;
+        if (!current.remove(key)) gone.append(key);
+    }
+    for (const QByteArray& key : qAsConst(gone)) removeTree(key);
+    for (const QByteArray& key : qAsConst(current)) scanSubtree(key);
+    if (cache) cacheTimer->start();
+}
+
+void FileIndex::rescan(const QByteArray& dir)
+{
+    QSharedPointer<FileIndexJob> shared = job;
+    QSharedPointer<const IgnoreRules> ignore = rules;
+    QString root = rootPath;
+    int generation = job->generation.loadRelaxed();
+    pool.start([shared, ignore, root, dir, generation]()
+    {
+        TRACE_SCOPE("FileIndex::rescan");
+        QVector<QByteArray> files;
+        QVector<QByteArray> subdirs;
+        QString relative = QString::fromUtf8(dir);
+        QDirIterator iter(absolute(root, dir), scanFilters);
+        while (iter.hasNext())
+        {
+            iter.next();
+            QString path = relative.isEmpty() ? iter.fileName() : relative + '/' + iter.fileName();
+            bool isDir = iter.fileInfo().isDir();
+            if (ignore->match(path, isDir) == 1) continue;
+            (isDir ? subdirs : files).append(path.toUtf8());
+        }
+        deliver(shared, generation, [dir, files, subdirs](FileIndex* index) { index->updateDir(dir, files, subdirs); });
+    });
+}
+
+void FileIndex::scanSubtree(const QByteArray& dir)
+{
+    dirs.insert(dir, QVector<int>());
+    QSharedPointer<FileIndexBuild> build(new FileIndexBuild);
+    build->job = job;
+    build->pool = &pool;
+    build->root = rootPath;
+    build->rules = rules;
+    build->generation = job->generation.loadRelaxed();
+    build->pending.storeRelaxed(1);
+    build->done = [](FileIndex* index, const FileIndexData& data) { index->merge(data); };
+    QString relative = QString::fromUtf8(dir);
+    pool.start([build, relative]() { scanTree(build, relative, spawnDepth); });
+}
+
+int FileIndex::insert(const QByteArray& path)
+{
+    int slot;
+    if (freeSlots.isEmpty())
+    {
+        slot = entries.size();
+        entries.append(path);
+        masks.append(charMask(path));
+    }
+    else
+    {
+        slot = freeSlots.takeLast();
+        entries[slot] = path;
+        masks[slot] = charMask(path);
+    }
+    ++count;
+    return slot;
+}
+
+void FileIndex::drop(int slot)
+{
+    entries[slot].clear();
+    masks[slot] = 0;
+    freeSlots.append(slot);
+    --count;
+}
+
+void FileIndex::removeTree(const QByteArray& dir)
+{
+    QByteArray prefix = dir + '/';
+    for (auto it = dirs.begin(); it != dirs.end();)
+    {
+        if (it.key() != dir && !it.key().startsWith(prefix))
+        {
+            ++it;
+            continue;
+        }
+        for (int slot : qAsConst(it.value())) drop(slot);
+        watcher->removePath(absolute(rootPath, it.key()));
+        it = dirs.erase(it);
+    }
+}
+
+void FileIndex::watch(const QVector<QByteArray>& list)
+{
+    int room = maxWatches - watcher->directories().size();
+    if (room <= 0) return;
+
+    QVector<QPair<int, QByteArray>> ordered;
+    ordered.reserve(list.size());
+    for (const QByteArray& dir : list) ordered.append(qMakePair(dir.isEmpty() ? 0 : int(dir.count('/')) + 1, dir));
+    std::sort(ordered.begin(), ordered.end());
+
+    QStringList paths;
+    for (int i = 0; i < ordered.size() && paths.size() < room; ++i) paths.append(absolute(rootPath, ordered.at(i).second));
+    if (!paths.isEmpty()) watcher->addPaths(paths);
+}
+
+void FileIndex::directoryChanged(const QString& path)
+{
+    QString relative = QDir(rootPath).relativeFilePath(path);
+    if (relative == ".") relative.clear();
+    if (relative.startsWith("..")) return;
+    changed.insert(relative.toUtf8());
+    rescanTimer->start();
+}
+
+void FileIndex::rescanChanged()
+{
+    for (const QByteArray& dir : qAsConst(changed)) rescan(dir);
+    changed.clear();
+}
+
+QString FileIndex::cachePath() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/fileindex/"
+        + QCryptographicHash::hash(rootPath.toUtf8(), QCryptographicHash::Md5).toHex() + ".bin";
+}
+
+void FileIndex::writeCache()
+{
+    if (!cache || building || rootPath.isEmpty()) return;
+    QVector<QByteArray> files;
+    files.reserve(count);
+    for (const QByteArray& entry : qAsConst(entries))
+    {
+        if (!entry.isEmpty()) files.append(entry);
+    }
+    QVector<QByteArray> dirList = dirs.keys();
+    QString file = cachePath();
+    QString root = rootPath;
+    pool.start([file, root, files, dirList]()
+    {
+        TRACE_SCOPE("FileIndex::writeCache");
+        QDir().mkpath(QFileInfo(file).path());
+        QSaveFile output(file);
+        if (!output.open(QIODevice::WriteOnly)) return;
+        QDataStream stream(&output);
+        stream << cacheMagic << cacheVersion << root << files << dirList;
+        if (stream.status() == QDataStream::Ok) output.commit();
+    });
+}
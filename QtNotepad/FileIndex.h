@@ -0,0 +1,82 @@
+#pragma once
+#include "ExplorerModel.h"
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+#include <QThreadPool>
+#include <QSharedPointer>
+#include <QFileSystemWatcher>
+
+struct FileIndexJob;
+
+struct FileIndexData
+{
+    QVector<QByteArray> entries;
+    QVector<quint64> masks;
+    QHash<QByteArray, QVector<int>> dirs;
+};
+
+class FileIndex : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FileIndex(QObject* parent = nullptr);
+    ~FileIndex();
+
+    void setRoot(const QString&);
+    QString root() const;
+    void setIgnorePatterns(const QStringList&);
+    void setMaxWatches(int);
+    void setCacheEnabled(bool);
+    int size() const;
+    bool isBuilding() const;
+    void query(const QString&, int);
+
+    static quint64 charMask(const QByteArray&);
+    static int score(const QByteArray&, const QByteArray&);
+
+signals:
+    void ready(int);
+    void results(const QString&, const QStringList&);
+
+private slots:
+    void directoryChanged(const QString&);
+    void rescanChanged();
+    void writeCache();
+
+private:
+    void loaded(const FileIndexData&, bool);
+    void merge(const FileIndexData&);
+    void updateDir(const QByteArray&, const QVector<QByteArray>&, const QVector<QByteArray>&);
+    void rescan(const QByteArray&);
+    void scanSubtree(const QByteArray&);
+    int insert(const QByteArray&);
+    void drop(int);
+    void removeTree(const QByteArray&);
+    void watch(const QVector<QByteArray>&);
+    QString cachePath() const;
+
+    QString rootPath;
+    QThreadPool pool;
+    QThreadPool queryPool;
+    QSharedPointer<FileIndexJob> job;
+    QSharedPointer<const IgnoreRules> rules;
+    QStringList patterns;
+    QFileSystemWatcher* watcher;
+    QTimer* rescanTimer;
+    QTimer* cacheTimer;
+    QSet<QByteArray> changed;
+    QVector<QByteArray> entries;
+    QVector<quint64> masks;
+    QVector<int> freeSlots;
+    QHash<QByteArray, QVector<int>> dirs;
+    int count;
+    int maxWatches;
+    bool cache;
+    bool building;
+};
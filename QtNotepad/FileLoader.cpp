@@ -0,0 +1,167 @@
+#include "FileLoader.h"
+#include "Trace.h"
+#include "FileCodec.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QEventLoop>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QTextCursor>
+#include <QProgressDialog>
+#include <QCoreApplication>
+#include <functional>
+
+static const qint64 chunkSize = 4 * 1024 * 1024;
+static const int maxQueuedChunks = 2;
+
+struct LoadJob
+{
+    QSemaphore credits{maxQueuedChunks};
+    QAtomicInt canceled;
+    bool closed = false;
+};
+
+FileLoader::FileLoader(const QString& filePath, QObject* parent) : QObject(parent), path(filePath), canceled(false)
+{
+}
+
+TextFormat FileLoader::format() const
+{
+    return textFormat;
+}
+
+bool FileLoader::wasCanceled() const
+{
+    return canceled;
+}
+
+QString FileLoader::errorString() const
+{
+    return error;
+}
+
+bool FileLoader::load(QTextDocument* document, QWidget* progressParent)
+{
+    TRACE_SCOPE("FileLoader::load");
+    QFileInfo info(path);
+    if (!info.isFile() || !info.isReadable())
+    {
+        error = tr("Can't open the file!");
+        return false;
+    }
+
+    bool undo = document->isUndoRedoEnabled();
+    document->setUndoRedoEnabled(false);
+    QTextCursor cursor(document);
+    cursor.movePosition(QTextCursor::End);
+    qint64 size = qMax<qint64>(1, info.size());
+
+    // A single chunk decodes faster than the progress dialog would appear, so
+    // it is read in place without spinning an event loop.
+    if (info.size() <= chunkSize)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) error = file.errorString();
+        else
+        {
+            QString text = FileCodec::decodeAll(file.readAll(), &textFormat);
+            if (file.error() != QFileDevice::NoError) error = file.errorString();
+            else cursor.insertText(text);
+        }
+        document->setUndoRedoEnabled(undo);
+        return error.isEmpty();
+    }
+
+    // The dialog is shown and made modal before the nested loop starts, so the
+    // window can't take input until the load has finished or was canceled.
+    QProgressDialog progress(tr("Opening %1").arg(info.fileName()), tr("Cancel"), 0, 1000, progressParent);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(0);
+    progress.setValue(0);
+
+    QEventLoop loop;
+    QSharedPointer<LoadJob> job(new LoadJob);
+    auto cancel = [this, job, &loop]()
+    {
+        if (job->closed) return;
+        canceled = true;
+        job->canceled.storeRelaxed(1);
+        job->credits.release(maxQueuedChunks);
+        loop.quit();
+    };
+    connect(&progress, &QProgressDialog::canceled, &loop, cancel);
+
+    std::function<void(const QString&, qint64)> deliver = [job, &cursor, &progress, size, cancel](const QString& text, qint64 offset)
+    {
+        if (job->closed || job->canceled.loadRelaxed()) return;
+        cursor.insertText(text);
+        progress.setValue(int(qMin<qint64>(offset, size) * 1000 / size));
+        job->credits.release();
+        if (progress.wasCanceled()) cancel();
+    };
+    std::function<void(const QString&, const TextFormat&)> finish = [this, job, &loop](const QString& errorString, const TextFormat& format)
+    {
+        if (job->closed || job->canceled.loadRelaxed()) return;
+        error = errorString;
+        textFormat = format;
+        loop.quit();
+    };
+
+    QString filePath = path;
+    QThreadPool::globalInstance()->start([job, filePath, deliver, finish]()
+    {
+        TRACE_SCOPE("FileLoader::read");
+        auto done = [finish](const QString& errorString, const TextFormat& format)
+        {
+            QMetaObject::invokeMethod(QCoreApplication::instance(), [finish, errorString, format]()
+            {
+                finish(errorString, format);
+            }, Qt::QueuedConnection);
+        };
+        auto push = [job, deliver](const QString& text, qint64 offset)
+        {
+            job->credits.acquire();
+            if (job->canceled.loadRelaxed()) return false;
+            QMetaObject::invokeMethod(QCoreApplication::instance(), [deliver, text, offset]()
+            {
+                deliver(text, offset);
+            }, Qt::QueuedConnection);
+            return true;
+        };
+
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            done(file.errorString(), TextFormat());
+            return;
+        }
+
+        qint64 size = file.size();
+        uchar* data = size > 0 ? file.map(0, size) : nullptr;
+        QByteArray buffer;
+        if (!data)
+        {
+            file.unsetError();
+            buffer = file.readAll();
+        }
+        QByteArrayView bytes = data ? QByteArrayView(data, size) : QByteArrayView(buffer);
+
+        FileCodec codec(FileCodec::detect(bytes));
+        bool pushed = true;
+        for (qint64 offset = 0; pushed && offset < bytes.size();)
+        {
+            QByteArrayView chunk = bytes.sliced(offset, qMin<qint64>(chunkSize, bytes.size() - offset));
+            offset += chunk.size();
+            pushed = push(codec.decode(chunk), offset);
+        }
+        QString rest = codec.flush();
+        if (pushed && !rest.isEmpty()) pushed = push(rest, bytes.size());
+        if (pushed) done(file.error() == QFileDevice::NoError ? QString() : file.errorString(), codec.format());
+    });
+
+    loop.exec();
+    job->closed = true;
+    document->setUndoRedoEnabled(undo);
+    return !canceled && error.isEmpty();
+}
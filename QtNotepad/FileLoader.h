@@ -0,0 +1,24 @@
+#pragma once
+#include "FileCodec.h"
+#include <QObject>
+#include <QString>
+#include <QTextDocument>
+#include <QWidget>
+
+class FileLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FileLoader(const QString&, QObject* parent = nullptr);
+
+    bool load(QTextDocument*, QWidget* progressParent = nullptr);
+    TextFormat format() const;
+    bool wasCanceled() const;
+    QString errorString() const;
+
+private:
+    QString path;
+    QString error;
+    TextFormat textFormat;
+    bool canceled;
+};
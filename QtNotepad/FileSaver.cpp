@@ -0,0 +1,140 @@
+#include "FileSaver.h"
+#include "Trace.h"
+#include <QSaveFile>
+#include <QStringView>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QCoreApplication>
+
+static const qsizetype encodeChunk = 4 * 1024 * 1024;
+
+struct SaveJob
+{
+    QMutex mutex;
+    FileSaver* saver;
+};
+
+void FileSaver::report(const QSharedPointer<SaveJob>& shared, quint64 id, const QString& path, int revision, const QString& error, bool unencodable)
+{
+    QMutexLocker locker(&shared->mutex);
+    FileSaver* saver = shared->saver;
+    if (!saver) return;
+    QMetaObject::invokeMethod(saver, [saver, id, path, revision, error, unencodable]()
+    {
+        saver->finish(path);
+        if (unencodable) emit saver->unencodable(id, path);
+        else if (error.isEmpty()) emit saver->saved(id, path, revision);
+        else emit saver->failed(id, path, error);
+    }, Qt::QueuedConnection);
+}
+
+FileSaver::FileSaver(QObject* parent) : QObject(parent), job(new SaveJob)
+{
+    job->saver = this;
+}
+
+FileSaver::~FileSaver()
+{
+    {
+        QMutexLocker locker(&job->mutex);
+        job->saver = nullptr;
+    }
+    pool.waitForDone();
+}
+
+bool FileSaver::isSaving(const QString& path) const
+{
+    return running.contains(path);
+}
+
+void FileSaver::waitForDone()
+{
+    do
+    {
+        pool.waitForDone();
+        QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+    } while (!running.isEmpty());
+}
+
+void FileSaver::submit(const QString& path, const std::function<void()>& task)
+{
+    if (running.contains(path))
+    {
+        queued.insert(path, task);
+        return;
+    }
+    running.insert(path);
+    pool.start(task);
+}
+
+void FileSaver::finish(const QString& path)
+{
+    if (queued.contains(path)) pool.start(queued.take(path));
+    else running.remove(path);
+}
+
+void FileSaver::save(quint64 id, const QString& path, const QString& text, int revision, const TextFormat& format)
+{
+    QSharedPointer<SaveJob> shared = job;
+    submit(path, [shared, id, path, text, revision, format]()
+    {
+        TRACE_SCOPE("FileSaver::write");
+        QSaveFile file(path);
+        bool ok = file.open(QIODevice::WriteOnly);
+        FileCodec codec(format);
+        QStringView view(text);
+        qsizetype i = 0;
+        do
+        {
+            qsizetype length = qMin(encodeChunk, view.size() - i);
+            if (i + length < view.size() && view.at(i + length - 1).isHighSurrogate()) ++length;
+            QByteArray bytes = codec.encode(view.mid(i, length));
+            if (codec.hasError())
+            {
+                file.cancelWriting();
+                report(shared, id, path, revision, QString(), true);
+                return;
+            }
+            ok = ok && file.write(bytes) == bytes.size();
+            i += length;
+        } while (ok && i < view.size());
+        if (ok) ok = file.commit();
+        else file.cancelWriting();
+        report(shared, id, path, revision, ok ? QString() : file.errorString());
+    });
+}
+
+void FileSaver::save(quint64 id, const QString& path, const PieceTable& table, int revision)
+{
+    QSharedPointer<SaveJob> shared = job;
+    submit(path, [shared, id, path, table, revision]() mutable
+    {
+        TRACE_SCOPE("FileSaver::writePieces");
+        QSharedPointer<QSaveFile> file(new QSaveFile(path));
+        bool ok = file->open(QIODevice::WriteOnly) && table.write(file.data());
+        table.clear();
+        if (!ok)
+        {
+            file->cancelWriting();
+            report(shared, id, path, revision, file->errorString());
+            return;
+        }
+
+        QMutexLocker locker(&shared->mutex);
+        FileSaver* saver = shared->saver;
+        if (!saver)
+        {
+            file->cancelWriting();
+            return;
+        }
+        file->moveToThread(saver->thread());
+        QMetaObject::invokeMethod(saver, [saver, file, id, path, revision]()
+        {
+            emit saver->aboutToReplace(id, path);
+            bool committed = file->commit();
+            saver->finish(path);
+            if (committed) emit saver->saved(id, path, revision);
+            else emit saver->failed(id, path, file->errorString());
+        }, Qt::QueuedConnection);
+    });
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "PieceTable.h"
+#include "FileCodec.h"
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <QSharedPointer>
+#include <QHash>
+#include <QSet>
+#include <functional>
+
+struct SaveJob;
+
+class FileSaver : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FileSaver(QObject* parent = nullptr);
+    ~FileSaver();
+
+    void save(quint64, const QString&, const QString&, int, const TextFormat& format = TextFormat());
+    void save(quint64, const QString&, const PieceTable&, int);
+    bool isSaving(const QString&) const;
+    void waitForDone();
+
+signals:
+    void aboutToReplace(quint64, const QString&);
+    void saved(quint64, const QString&, int);
+    void failed(quint64, const QString&, const QString&);
+    void unencodable(quint64, const QString&);
+
+private:
+    void submit(const QString&, const std::function<void()>&);
+    void finish(const QString&);
+    static void report(const QSharedPointer<SaveJob>&, quint64, const QString&, int, const QString&, bool unencodable = false);
+
+    QThreadPool pool;
+    QSharedPointer<SaveJob> job;
+    QHash<QString, std::function<void()>> queued;
+    QSet<QString> running;
+};
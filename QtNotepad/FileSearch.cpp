@@ -0,0 +1,227 @@
+#include "FileSearch.h"
+#include <QDirIterator>
+#include <QFile>
+#include <QByteArrayView>
+#include <QRegularExpression>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAtomicInt>
+#include <algorithm>
+#include <cstring>
+
+static const int filesPerTask = 64;
+static const int sniffLength = 8192;
+static const int maxLineText = 200;
+
+struct FileSearchJob
+{
+    QMutex mutex;
+    FileSearch* search;
+    QAtomicInt generation;
+};
+
+struct FileSearchRun
+{
+    QSharedPointer<FileSearchJob> job;
+    QThreadPool* pool;
+    SearchQuery query;
+    QRegularExpression expression;
+    QByteArray needle;
+    qint64 sizeLimit;
+    int maxHits;
+    int generation;
+    QAtomicInt pending;
+    QAtomicInt files;
+    QAtomicInt hits;
+
+    bool canceled() const { return job->generation.loadRelaxed() != generation; }
+};
+
+template <typename Char>
+static QString lineAt(const Char* data, qint64 size, qint64 position, qint64& line, qint64& counted, qint64& lineStart)
+{
+    for (const Char* p = data + counted; p < data + position; ++p)
+    {
+        if (*p == '\n')
+        {
+            ++line;
+            lineStart = p - data + 1;
+        }
+    }
+    counted = position;
+
+    qint64 end = position;
+    while (end < size && data[end] != '\n' && end - lineStart < maxLineText) ++end;
+    if constexpr (sizeof(Char) == 1) return QString::fromUtf8(reinterpret_cast<const char*>(data + lineStart), end - lineStart).trimmed();
+    else return QString(reinterpret_cast<const QChar*>(data + lineStart), end - lineStart).trimmed();
+}
+
+static void deliver(const QSharedPointer<FileSearchRun>& run, const QVector<FileHit>& hits)
+{
+    QMutexLocker locker(&run->job->mutex);
+    FileSearch* search = run->job->search;
+    if (!search || hits.isEmpty()) return;
+    QSharedPointer<FileSearchJob> job = run->job;
+    int generation = run->generation;
+    QMetaObject::invokeMethod(search, [job, search, hits, generation]()
+    {
+        if (job->generation.loadRelaxed() == generation) emit search->found(hits);
+    }, Qt::QueuedConnection);
+}
+
+static void complete(const QSharedPointer<FileSearchRun>& run)
+{
+    if (!run->pending.deref())
+    {
+        QMutexLocker locker(&run->job->mutex);
+        FileSearch* search = run->job->search;
+        if (!search) return;
+        QSharedPointer<FileSearchJob> job = run->job;
+        int generation = run->generation;
+        int files = run->files.loadRelaxed();
+        int hits = run->hits.loadRelaxed();
+        QMetaObject::invokeMethod(search, [job, search, files, hits, generation]()
+        {
+            if (job->generation.loadRelaxed() == generation) emit search->finished(files, hits);
+        }, Qt::QueuedConnection);
+    }
+}
+
+static void scanFile(const QSharedPointer<FileSearchRun>& run, const QString& path, QVector<FileHit>& hits)
+{
+    QFile file(path);
+    if (file.size() == 0 || file.size() > run->sizeLimit || !file.open(QIODevice::ReadOnly)) return;
+    qint64 size = file.size();
+    uchar* mapped = file.map(0, size);
+    QByteArray buffer;
+    if (!mapped)
+    {
+        file.unsetError();
+        buffer = file.readAll();
+        mapped = reinterpret_cast<uchar*>(buffer.data());
+        size = buffer.size();
+    }
+    const char* data = reinterpret_cast<const char*>(mapped);
+    if (memchr(data, 0, qMin<qint64>(size, sniffLength))) return;
+    run->files.ref();
+
+    qint64 line = 1;
+    qint64 counted = 0;
+    qint64 lineStart = 0;
+    qint64 lastLine = 0;
+    auto add = [&](qint64 number, const QString& text)
+    {
+        if (number == lastLine) return true;
+        lastLine = number;
+        if (run->hits.fetchAndAddRelaxed(1) >= run->maxHits) return false;
+        hits.append({ path, number, text });
+        return true;
+    };
+
+    if (!run->query.regex && run->query.sensitivity == Qt::CaseSensitive)
+    {
+        QByteArrayView view(data, size);
+        qsizetype i = view.indexOf(run->needle);
+        while (i >= 0)
+        {
+            QString text = lineAt(data, size, i, line, counted, lineStart);
+            if (!add(line, text)) return;
+            i = view.indexOf(run->needle, i + run->needle.size());
+        }
+        return;
+    }
+
+    QString text = QString::fromUtf8(data, size);
+    const QChar* chars = text.constData();
+    if (run->query.regex)
+    {
+        QRegularExpressionMatchIterator iter = run->expression.globalMatch(text);
+        while (iter.hasNext())
+        {
+            QRegularExpressionMatch match = iter.next();
+            QString hit = lineAt(reinterpret_cast<const ushort*>(chars), text.size(), match.capturedStart(), line, counted, lineStart);
+            if (!add(line, hit)) return;
+        }
+        return;
+    }
+
+    QStringView view(text);
+    qsizetype i = view.indexOf(run->query.pattern, 0, Qt::CaseInsensitive);
+    while (i >= 0)
+    {
+        QString hit = lineAt(reinterpret_cast<const ushort*>(chars), text.size(), i, line, counted, lineStart);
+        if (!add(line, hit)) return;
+        i = view.indexOf(run->query.pattern, i + run->query.pattern.size(), Qt::CaseInsensitive);
+    }
+}
+
+static void scanFiles(const QSharedPointer<FileSearchRun>& run, const QStringList& paths)
+{
+    QVector<FileHit> hits;
+    for (const QString& path : paths)
+    {
+        if (run->canceled() || run->hits.loadRelaxed() >= run->maxHits) break;
+        scanFile(run, path, hits);
+    }
+    if (!run->canceled()) deliver(run, hits);
+    complete(run);
+}
+
+FileSearch::FileSearch(QObject* parent) : QObject(parent), job(new FileSearchJob)
+{
+    job->search = this;
+}
+
+FileSearch::~FileSearch()
+{
+    cancel();
+    {
+        QMutexLocker locker(&job->mutex);
+        job->search = nullptr;
+    }
+    pool.waitForDone();
+}
+
+void FileSearch::cancel()
+{
+    job->generation.fetchAndAddRelaxed(1);
+}
+
+void FileSearch::start(const QString& root, const SearchQuery& query, qint64 sizeLimit, int maxHits)
+{
+    cancel();
+    if (!SearchEngine::check(query).isEmpty()) return;
+
+    QSharedPointer<FileSearchRun> run(new FileSearchRun);
+    run->job = job;
+    run->pool = &pool;
+    run->query = query;
+    run->expression = QRegularExpression(query.pattern, QRegularExpression::MultilineOption | (query.sensitivity == Qt::CaseInsensitive
+        ? QRegularExpression::CaseInsensitiveOption : QRegularExpression::NoPatternOption));
+    run->expression.optimize();
+    run->needle = query.pattern.toUtf8();
+    run->sizeLimit = sizeLimit;
+    run->maxHits = maxHits;
+    run->generation = job->generation.loadRelaxed();
+    run->pending.storeRelaxed(1);
+
+    pool.start([run, root]()
+    {
+        QDirIterator iter(root, QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks, QDirIterator::Subdirectories);
+        QStringList batch;
+        while (iter.hasNext() && !run->canceled())
+        {
+            batch << iter.next();
+            if (batch.size() < filesPerTask) continue;
+            run->pending.ref();
+            run->pool->start([run, batch]() { scanFiles(run, batch); });
+            batch.clear();
+        }
+        if (!batch.isEmpty() && !run->canceled())
+        {
+            run->pending.ref();
+            run->pool->start([run, batch]() { scanFiles(run, batch); });
+        }
+        complete(run);
+    });
+}
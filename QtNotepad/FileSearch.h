@@ -0,0 +1,35 @@
+#pragma once
+#include "SearchEngine.h"
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QThreadPool>
+#include <QSharedPointer>
+
+struct FileSearchJob;
+
+struct FileHit
+{
+    QString path;
+    qint64 line;
+    QString text;
+};
+
+class FileSearch : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FileSearch(QObject* parent = nullptr);
+    ~FileSearch();
+
+    void start(const QString&, const SearchQuery&, qint64, int);
+    void cancel();
+
+signals:
+    void found(const QVector<FileHit>&);
+    void finished(int, int);
+
+private:
+    QThreadPool pool;
+    QSharedPointer<FileSearchJob> job;
+};
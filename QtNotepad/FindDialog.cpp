@@ -0,0 +1,76 @@
+#include "FindDialog.h"
+
+FindDialog::FindDialog(QWidget* parent) : QDialog(parent)
+{
+    setWindowTitle(tr("Find"));
+    findEdit = new QLineEdit;
+    replaceEdit = new QLineEdit;
+    replaceLabel = new QLabel(tr("Replace with:"));
+    caseBox = new QCheckBox(tr("Match case"));
+    regexBox = new QCheckBox(tr("Regular expression"));
+    allTabsBox = new QCheckBox(tr("All open tabs"));
+    btnFind = new QPushButton(tr("Find all"));
+    btnNext = new QPushButton(tr("Find next"));
+    btnPrevious = new QPushButton(tr("Find previous"));
+    btnReplace = new QPushButton(tr("Replace all"));
+    status = new QLabel;
+    btnFind->setDefault(true);
+
+    QGridLayout* layout = new QGridLayout;
+    layout->addWidget(new QLabel(tr("Find what:")), 0, 0);
+    layout->addWidget(findEdit, 0, 1, 1, 3);
+    layout->addWidget(replaceLabel, 1, 0);
+    layout->addWidget(replaceEdit, 1, 1, 1, 3);
+    layout->addWidget(caseBox, 2, 0);
+    layout->addWidget(regexBox, 2, 1);
+    layout->addWidget(allTabsBox, 2, 2);
+    layout->addWidget(btnFind, 3, 0);
+    layout->addWidget(btnNext, 3, 1);
+    layout->addWidget(btnPrevious, 3, 2);
+    layout->addWidget(btnReplace, 3, 3);
+    layout->addWidget(status, 4, 0, 1, 4);
+    setLayout(layout);
+
+    connect(btnFind, SIGNAL(clicked()), SIGNAL(findRequested()));
+    connect(btnNext, SIGNAL(clicked()), SIGNAL(nextRequested()));
+    connect(btnPrevious, SIGNAL(clicked()), SIGNAL(previousRequested()));
+    connect(btnReplace, SIGNAL(clicked()), SIGNAL(replaceRequested()));
+    connect(findEdit, SIGNAL(returnPressed()), SIGNAL(findRequested()));
+}
+
+void FindDialog::showFind(bool replace)
+{
+    setWindowTitle(replace ? tr("Replace") : tr("Find"));
+    replaceLabel->setVisible(replace);
+    replaceEdit->setVisible(replace);
+    btnReplace->setVisible(replace);
+    show();
+    raise();
+    activateWindow();
+    findEdit->setFocus();
+    findEdit->selectAll();
+}
+
+SearchQuery FindDialog::query() const
+{
+    SearchQuery query;
+    query.pattern = findEdit->text();
+    query.regex = regexBox->isChecked();
+    query.sensitivity = caseBox->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    return query;
+}
+
+QString FindDialog::replacement() const
+{
+    return replaceEdit->text();
+}
+
+bool FindDialog::allTabs() const
+{
+    return allTabsBox->isChecked();
+}
+
+void FindDialog::setStatus(const QString& text)
+{
+    status->setText(text);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "SearchEngine.h"
+#include <QDialog>
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QPushButton>
+#include <QLabel>
+#include <QGridLayout>
+
+class FindDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit FindDialog(QWidget* parent = nullptr);
+
+    void showFind(bool replace);
+    SearchQuery query() const;
+    QString replacement() const;
+    bool allTabs() const;
+    void setStatus(const QString&);
+
+signals:
+    void findRequested();
+    void nextRequested();
+    void previousRequested();
+    void replaceRequested();
+
+private:
+    QLineEdit* findEdit;
+    QLineEdit* replaceEdit;
+    QLabel* replaceLabel;
+    QCheckBox* caseBox;
+    QCheckBox* regexBox;
+    QCheckBox* allTabsBox;
+    QPushButton* btnFind;
+    QPushButton* btnNext;
+    QPushButton* btnPrevious;
+    QPushButton* btnReplace;
+    QLabel* status;
+};
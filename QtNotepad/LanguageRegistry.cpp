@@ -0,0 +1,328 @@
+#include "LanguageRegistry.h"
+#include <QDomDocument>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QFile>
+#include <QLoggingCategory>
+#include <climits>
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(lcLanguage, "qtnotepad.language", QtWarningMsg)
+
+static inline bool isWordChar(QChar c)
+{
+    ushort u = c.unicode();
+    return (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') || (u >= '0' && u <= '9') || u == '_';
+}
+
+int LanguageDefinition::highlightLine(const QString& txt, int previousState, QVector<QTextLayout::FormatRange>& ranges) const
+{
+    QVector<const QTextCharFormat*> formats(txt.size(), nullptr);
+    auto setFormat = [&formats](int start, int count, const QTextCharFormat& format)
+    {
+        int end = qMin(start + count, int(formats.size()));
+        if (start < end) std::fill(formats.begin() + start, formats.begin() + end, &format);
+    };
+
+    QElapsedTimer timer;
+    for (int i = 0; i <= rules.size(); ++i)
+    {
+        if (i == keywordPass)
+        {
+            timer.start();
+            int hits = 0;
+            const QChar* data = txt.constData();
+            const int size = txt.size();
+            int k = 0;
+            while (k < size)
+            {
+                if (!isWordChar(data[k]))
+                {
+                    ++k;
+                    continue;
+                }
+                int start = k;
+                while (k < size && isWordChar(data[k])) ++k;
+                int length = k - start;
+                if (length < keywordMinLength || length > keywordMaxLength) continue;
+
+                auto iter = keywords.constFind(QStringView(data + start, length));
+                if (iter != keywords.constEnd())
+                {
+                    setFormat(start, length, keywordFormats.at(iter.value()));
+                    ++hits;
+                }
+            }
+            if (keywordStats) keywordStats->record(timer.nsecsElapsed(), hits, size, false);
+        }
+        if (i == rules.size()) break;
+
+        const HighlightingRule& rule = rules.at(i);
+        if (rule.stats->disabled.loadRelaxed()) continue;
+        timer.start();
+        int hits = 0;
+        QRegularExpressionMatchIterator iter = rule.pattern.globalMatch(txt);
+        while (iter.hasNext())
+        {
+            QRegularExpressionMatch match = iter.next();
+            setFormat(match.capturedStart(), match.capturedLength(), rule.format);
+            ++hits;
+        }
+        rule.stats->record(timer.nsecsElapsed(), hits, txt.size(), true);
+    }
+
+    int state = 0;
+    if (!commentStartExpression.pattern().isEmpty())
+    {
+        int first = 0;
+        if (previousState != 1) first = txt.indexOf(commentStartExpression);
+
+        while (first >= 0)
+        {
+            QRegularExpressionMatch match = commentEndExpression.match(txt, first);
+            int last = match.capturedStart();
+            int length = 0;
+            if (last == -1)
+            {
+                state = 1;
+                length = txt.length() - first;
+            }
+            else length = last - first + match.capturedLength();
+            setFormat(first, length, multiLineCommentFormat);
+            first = txt.indexOf(commentStartExpression, length + first);
+        }
+    }
+
+    int i = 0;
+    while (i < formats.size())
+    {
+        const QTextCharFormat* format = formats.at(i);
+        if (!format)
+        {
+            ++i;
+            continue;
+        }
+        QTextLayout::FormatRange range;
+        range.start = i;
+        while (i < formats.size() && formats.at(i) == format) ++i;
+        range.length = i - range.start;
+        range.format = *format;
+        ranges.append(range);
+    }
+    return state;
+}
+
+int LanguageDefinition::lineState(const QString& txt, int previousState) const
+{
+    if (commentStartExpression.pattern().isEmpty()) return 0;
+
+    int first = 0;
+    if (previousState != 1) first = txt.indexOf(commentStartExpression);
+    while (first >= 0)
+    {
+        QRegularExpressionMatch match = commentEndExpression.match(txt, first);
+        if (!match.hasMatch()) return 1;
+        first = txt.indexOf(commentStartExpression, match.capturedEnd());
+    }
+    return 0;
+}
+
+void RuleStats::record(qint64 elapsed, int hits, int length, bool budgeted)
+{
+    attempts.fetchAndAddRelaxed(1);
+    matches.fetchAndAddRelaxed(hits);
+    totalNs.fetchAndAddRelaxed(elapsed);
+    qint64 worst = worstNs.loadRelaxed();
+    while (elapsed > worst && !worstNs.testAndSetRelaxed(worst, elapsed, worst)) {}
+
+    qint64 budget = LanguageRegistry::ruleBudget();
+    if (!budgeted || budget <= 0) return;
+    budget *= qMax(1, (length + LanguageRegistry::budgetLength - 1) / LanguageRegistry::budgetLength);
+    if (elapsed <= budget)
+    {
+        if (strikes.loadRelaxed() > 0 && clean.fetchAndAddRelaxed(1) + 1 >= LanguageRegistry::strikeDecay)
+        {
+            clean.storeRelaxed(0);
+            int current = strikes.loadRelaxed();
+            while (current > 0 && !strikes.testAndSetRelaxed(current, current - 1, current)) {}
+        }
+        return;
+    }
+    overBudget.fetchAndAddRelaxed(1);
+    clean.storeRelaxed(0);
+    if (strikes.fetchAndAddRelaxed(1) + 1 >= LanguageRegistry::ruleStrikes()) disabled.storeRelaxed(1);
+}
+
+void RuleStats::reset()
+{
+    attempts.storeRelaxed(0);
+    matches.storeRelaxed(0);
+    totalNs.storeRelaxed(0);
+    worstNs.storeRelaxed(0);
+    overBudget.storeRelaxed(0);
+    strikes.storeRelaxed(0);
+    clean.storeRelaxed(0);
+    disabled.storeRelaxed(0);
+    reported.storeRelaxed(0);
+}
+
+QAtomicInteger<qint64> LanguageRegistry::budgetNs(2000000);
+QAtomicInt LanguageRegistry::strikes(3);
+
+void LanguageRegistry::setRuleBudget(qint64 nsecs, int count)
+{
+    budgetNs.storeRelaxed(nsecs);
+    strikes.storeRelaxed(qMax(1, count));
+}
+
+qint64 LanguageRegistry::ruleBudget()
+{
+    return budgetNs.loadRelaxed();
+}
+
+int LanguageRegistry::ruleStrikes()
+{
+    return strikes.loadRelaxed();
+}
+
+LanguageRegistry& LanguageRegistry::instance()
+{
+    static LanguageRegistry registry;
+    return registry;
+}
+
+QSharedPointer<const LanguageDefinition> LanguageRegistry::definition(const QString& extension, const QString& style)
+{
+    QMutexLocker locker(&mutex);
+    if (!styles.contains(style)) load(style);
+    return styles.value(style).value(extension);
+}
+
+QList<QSharedPointer<const LanguageDefinition>> LanguageRegistry::definitions()
+{
+    QMutexLocker locker(&mutex);
+    QList<QSharedPointer<const LanguageDefinition>> list;
+    for (const auto& byExtension : qAsConst(styles))
+    {
+        for (const QSharedPointer<const LanguageDefinition>& language : byExtension)
+            if (!list.contains(language)) list.append(language);
+    }
+    return list;
+}
+
+qint64 LanguageRegistry::loadTime()
+{
+    QMutexLocker locker(&mutex);
+    return loadTimeNs;
+}
+
+qint64 LanguageRegistry::compileTime()
+{
+    QMutexLocker locker(&mutex);
+    return compileTimeNs;
+}
+
+void LanguageRegistry::load(const QString& style)
+{
+    QElapsedTimer timer;
+    timer.start();
+    qint64 compileBefore = compileTimeNs;
+
+    QHash<QString, QSharedPointer<const LanguageDefinition>>& byExtension = styles[style];
+    QDomDocument domDocument;
+    QFile file(style);
+    int errorColumn;
+    int errorRow;
+    QString errorStr;
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qCWarning(lcLanguage) << "Can't open style file" << style;
+        return;
+    }
+    if (!domDocument.setContent(&file, &errorStr, &errorRow, &errorColumn))
+    {
+        qCWarning(lcLanguage) << errorStr
+            << " Error string " << errorRow
+            << " Error column " << errorColumn;
+        return;
+    }
+
+    QDomElement root = domDocument.documentElement();
+    auto nodes = root.elementsByTagName("syntax");
+    for (int i = 0; i < nodes.count(); ++i)
+    {
+        QDomElement syntax = nodes.item(i).toElement();
+        QSharedPointer<LanguageDefinition> language(new LanguageDefinition);
+        language->id = syntax.attribute("id");
+        language->name = syntax.attribute("name");
+        language->extensions = syntax.attribute("list").split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
+        language->keywordMinLength = INT_MAX;
+        language->keywordStats.reset(new RuleStats);
+        language->multiLineCommentFormat.setForeground(QColor(0, 255, 255));
+
+        auto ruleNodes = syntax.elementsByTagName("rule");
+        for (int j = 0; j < ruleNodes.count(); ++j)
+        {
+            auto format = ruleNodes.item(j).toElement().elementsByTagName("format");
+            auto pattern = ruleNodes.item(j).toElement().elementsByTagName("pattern");
+            QTextCharFormat ruleFormat;
+            ruleFormat.setFontWeight(format.at(0).toElement().attribute("font_weight").toInt());
+            ruleFormat.setForeground(QColor(format.item(0).toElement().attribute("foreground")));
+            addRule(*language, pattern.item(0).toElement().attribute("value"), ruleFormat);
+        }
+
+        auto first = syntax.elementsByTagName("startComment").item(0).toElement();
+        auto last = syntax.elementsByTagName("endComment").item(0).toElement();
+        QString firstNode = first.elementsByTagName("pattern").at(0).toElement().attribute("value");
+        QString lastNode = last.elementsByTagName("pattern").at(0).toElement().attribute("value");
+        if (!firstNode.isEmpty() && !lastNode.isEmpty())
+        {
+            language->commentStartExpression = QRegularExpression(firstNode);
+            language->commentEndExpression = QRegularExpression(lastNode);
+            language->commentStartExpression.optimize();
+            language->commentEndExpression.optimize();
+        }
+
+        QSharedPointer<const LanguageDefinition> shared = language;
+        for (const QString& extension : qAsConst(language->extensions)) byExtension.insert(extension, shared);
+    }
+
+    qint64 elapsed = timer.nsecsElapsed();
+    loadTimeNs += elapsed;
+    qCDebug(lcLanguage) << "Loaded" << style << "in" << elapsed / 1000 << "us, regex compile"
+        << (compileTimeNs - compileBefore) / 1000 << "us";
+}
+
+void LanguageRegistry::addRule(LanguageDefinition& language, const QString& pattern, const QTextCharFormat& format)
+{
+    static const QRegularExpression keywordPattern("^\\\\b(\\w+)\\\\b$");
+    QRegularExpressionMatch match = keywordPattern.match(pattern);
+    if (!match.hasMatch())
+    {
+        QElapsedTimer timer;
+        timer.start();
+        HighlightingRule rule;
+        rule.pattern = QRegularExpression(pattern);
+        rule.pattern.optimize();
+        rule.format = format;
+        rule.stats.reset(new RuleStats);
+        language.rules.append(rule);
+        compileTimeNs += timer.nsecsElapsed();
+        return;
+    }
+
+    int formatIndex = language.keywordFormats.indexOf(format);
+    if (formatIndex == -1)
+    {
+        formatIndex = language.keywordFormats.size();
+        language.keywordFormats.append(format);
+    }
+    if (language.keywordPass == -1) language.keywordPass = language.rules.size();
+
+    language.keywordNames.append(match.captured(1));
+    const QString& name = language.keywordNames.last();
+    language.keywords.insert(QStringView(name), formatIndex);
+    language.keywordMinLength = qMin(language.keywordMinLength, int(name.size()));
+    language.keywordMaxLength = qMax(language.keywordMaxLength, int(name.size()));
+}
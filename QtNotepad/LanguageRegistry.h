@@ -0,0 +1,94 @@
+#pragma once
+#include <QRegularExpression>
+#include <QTextCharFormat>
+#include <QTextLayout>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QStringView>
+#include <QHash>
+#include <QVector>
+#include <QMutex>
+#include <QAtomicInteger>
+
+struct RuleStats
+{
+    QAtomicInteger<qint64> attempts;
+    QAtomicInteger<qint64> matches;
+    QAtomicInteger<qint64> totalNs;
+    QAtomicInteger<qint64> worstNs;
+    QAtomicInt overBudget;
+    QAtomicInt strikes;
+    QAtomicInt clean;
+    QAtomicInt disabled;
+    QAtomicInt reported;
+
+    void record(qint64, int, int, bool);
+    void reset();
+};
+
+struct HighlightingRule
+{
+    QRegularExpression pattern;
+    QTextCharFormat format;
+    QSharedPointer<RuleStats> stats;
+};
+
+struct LanguageDefinition
+{
+    QString id;
+    QString name;
+    QStringList extensions;
+
+    QVector<HighlightingRule> rules;
+    QStringList keywordNames;
+    QHash<QStringView, int> keywords;
+    QVector<QTextCharFormat> keywordFormats;
+    int keywordPass = -1;
+    int keywordMinLength = 0;
+    int keywordMaxLength = 0;
+    QSharedPointer<RuleStats> keywordStats;
+
+    QTextCharFormat multiLineCommentFormat;
+    QRegularExpression commentStartExpression;
+    QRegularExpression commentEndExpression;
+
+    int highlightLine(const QString&, int, QVector<QTextLayout::FormatRange>&) const;
+    int lineState(const QString&, int) const;
+};
+
+class LanguageRegistry
+{
+public:
+    static LanguageRegistry& instance();
+
+    QSharedPointer<const LanguageDefinition> definition(const QString& extension,
+        const QString& style_filename = ":/settings/styles.xml");
+
+    QList<QSharedPointer<const LanguageDefinition>> definitions();
+    qint64 loadTime();
+    qint64 compileTime();
+
+    // The per-line budget covers lines up to budgetLength characters and grows
+    // linearly past that; one strike is forgiven per strikeDecay lines in budget.
+    static const int budgetLength = 1024;
+    static const int strikeDecay = 100;
+
+    static void setRuleBudget(qint64, int);
+    static qint64 ruleBudget();
+    static int ruleStrikes();
+
+private:
+    LanguageRegistry() = default;
+    LanguageRegistry(const LanguageRegistry&) = delete;
+    LanguageRegistry& operator=(const LanguageRegistry&) = delete;
+
+    void load(const QString&);
+    void addRule(LanguageDefinition&, const QString&, const QTextCharFormat&);
+
+    QMutex mutex;
+    QHash<QString, QHash<QString, QSharedPointer<const LanguageDefinition>>> styles;
+    qint64 loadTimeNs = 0;
+    qint64 compileTimeNs = 0;
+    static QAtomicInteger<qint64> budgetNs;
+    static QAtomicInt strikes;
+};
@@ -0,0 +1,460 @@
+#include "LargeFileViewer.h"
+#include "Trace.h"
+#include <QPainter>
+#include <QScrollBar>
+#include <QMouseEvent>
+#include <QKeyEvent>
+#include <QGuiApplication>
+#include <QClipboard>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QFile>
+#include <algorithm>
+#include <climits>
+
+static const int indexBatch = 256;
+static const int maxLineBytes = 4096;
+static const int maxUndo = 10000;
+
+struct IndexJob
+{
+    QMutex mutex;
+    LargeFileViewer* viewer;
+};
+
+LargeFileViewer::LargeFileViewer(const QString& path, QWidget* parent) : QAbstractScrollArea(parent),
+    filePath(path), job(new IndexJob), newline("\n"), cursor(0), current(0), column(0), changes(0),
+    numberWidth(0), textWidth(0), indexing(false), saving(false)
+{
+    job->viewer = this;
+    lineNumberArea = new NumberArea(this, this);
+    setViewportMargins(lineNumberAreaWidth(), 0, 0, 0);
+    setFocusPolicy(Qt::StrongFocus);
+    viewport()->setCursor(Qt::IBeamCursor);
+}
+
+LargeFileViewer::~LargeFileViewer()
+{
+    QMutexLocker locker(&job->mutex);
+    job->viewer = nullptr;
+}
+
+bool LargeFileViewer::open()
+{
+    if (!table.map(filePath)) return false;
+    undoStack.clear();
+    cursor = 0;
+    current = 0;
+
+    qint64 size = QFile(filePath).size();
+    if (size == 0) return true;
+
+    indexing = true;
+    QSharedPointer<IndexJob> shared = job;
+    QString indexPath = filePath;
+    QThreadPool::globalInstance()->start([shared, indexPath, size]()
+    {
+        TRACE_SCOPE("LargeFileViewer::index");
+        QFile source(indexPath);
+        const char* bytes = source.open(QIODevice::ReadOnly) ? reinterpret_cast<const char*>(source.map(0, size)) : nullptr;
+        QVector<qint64> pieces;
+        qint64 offset = 0;
+        bool finished = false;
+        while (!finished)
+        {
+            pieces.clear();
+            while (bytes && offset < size && pieces.size() < indexBatch * 3)
+            {
+                qint64 length = qMin(PieceTable::maxPiece, size - offset);
+                pieces << offset << length << std::count(bytes + offset, bytes + offset + length, '\n');
+                offset += length;
+            }
+            finished = !bytes || offset >= size;
+
+            QMutexLocker locker(&shared->mutex);
+            LargeFileViewer* viewer = shared->viewer;
+            if (!viewer) return;
+            QMetaObject::invokeMethod(viewer, [viewer, pieces, finished]() { viewer->appendPieces(pieces, finished); }, Qt::QueuedConnection);
+        }
+    });
+    return true;
+}
+
+bool LargeFileViewer::reload()
+{
+    qint64 line = current;
+    QSharedPointer<IndexJob> old = job;
+    {
+        QMutexLocker locker(&old->mutex);
+        old->viewer = nullptr;
+    }
+    job.reset(new IndexJob);
+    job->viewer = this;
+    if (!open()) return false;
+    goToLine(qMin(line, table.lineCount() - 1));
+    return true;
+}
+
+void LargeFileViewer::release()
+{
+    table.detach();
+}
+
+bool LargeFileViewer::restore()
+{
+    bool ok = table.attach(filePath);
+    viewport()->update();
+    return ok;
+}
+
+void LargeFileViewer::setSaving(bool value)
+{
+    saving = value;
+}
+
+QString LargeFileViewer::path() const
+{
+    return filePath;
+}
+
+qint64 LargeFileViewer::lineCount() const
+{
+    return table.lineCount();
+}
+
+qint64 LargeFileViewer::currentLine() const
+{
+    return current;
+}
+
+qint64 LargeFileViewer::memoryUsage() const
+{
+    return table.memoryUsage();
+}
+
+int LargeFileViewer::revision() const
+{
+    return changes;
+}
+
+PieceTable LargeFileViewer::snapshot() const
+{
+    return table;
+}
+
+void LargeFileViewer::goToLine(qint64 line)
+{
+    moveCursor(table.lineStart(qBound<qint64>(0, line, table.lineCount() - 1)));
+    verticalScrollBar()->setValue(int(qMax<qint64>(0, current - visibleLines() / 2)));
+}
+
+void LargeFileViewer::appendPieces(const QVector<qint64>& pieces, bool finished)
+{
+    for (int i = 0; i + 2 < pieces.size(); i += 3) table.appendOriginal(pieces.at(i), pieces.at(i + 1), pieces.at(i + 2));
+    if (pieces.size() >= 3 && pieces.at(0) == 0)
+    {
+        QByteArray head = table.text(0, qMin<qint64>(table.size(), PieceTable::maxPiece));
+        newline = head.contains("\r\n") ? QByteArray("\r\n") : QByteArray("\n");
+    }
+    indexing = !finished;
+    int width = numberWidth;
+    if (lineNumberAreaWidth() != width) updateGutter();
+    updateScrollBars();
+    viewport()->update();
+    lineNumberArea->update();
+}
+
+int LargeFileViewer::lineNumberAreaWidth()
+{
+    int numbers = 1;
+    qint64 m = qMax<qint64>(1, table.lineCount());
+    while (m >= 10)
+    {
+        m /= 10;
+        ++numbers;
+    }
+    numberWidth = 3 + numbers * fontMetrics().horizontalAdvance(QLatin1Char('9'));
+    return numberWidth;
+}
+
+void LargeFileViewer::lineNumberAreaPaintEvent(QPaintEvent* event)
+{
+    TRACE_SCOPE("LargeFileViewer::lineNumberAreaPaintEvent");
+    QPainter painter(lineNumberArea);
+    painter.fillRect(event->rect(), Qt::lightGray);
+    painter.setPen(Qt::black);
+
+    int height = fontMetrics().height();
+    qint64 line = verticalScrollBar()->value();
+    for (int top = 0; top <= event->rect().bottom() && line < table.lineCount(); top += height, ++line)
+    {
+        if (top + height >= event->rect().top())
+            painter.drawText(0, top, lineNumberArea->width(), height, Qt::AlignRight, QString::number(line + 1));
+    }
+}
+
+QString LargeFileViewer::lineText(qint64 line, QVector<int>* offsets) const
+{
+    qint64 start = table.lineStart(line);
+    qint64 end = table.lineEnd(line);
+    if (end > start && table.at(end - 1) == '\r') --end;
+    QByteArray bytes = table.text(start, qMin<qint64>(end - start, maxLineBytes));
+    if (!offsets) return QString::fromUtf8(bytes);
+
+    QString text;
+    text.reserve(bytes.size());
+    offsets->clear();
+    for (int i = 0; i < bytes.size();)
+    {
+        int next = i + 1;
+        while (next < bytes.size() && (uchar(bytes.at(next)) & 0xC0) == 0x80) ++next;
+        int size = text.size();
+        if (next == i + 1 && uchar(bytes.at(i)) < 0x80) text.append(QLatin1Char(bytes.at(i)));
+        else text.append(QString::fromUtf8(bytes.constData() + i, next - i));
+        for (int k = size; k < text.size(); ++k) offsets->append(i);
+        i = next;
+    }
+    offsets->append(bytes.size());
+    return text;
+}
+
+int LargeFileViewer::visibleLines() const
+{
+    return qMax(1, viewport()->height() / fontMetrics().height());
+}
+
+int LargeFileViewer::columnX(const QString& text, int column) const
+{
+    return fontMetrics().size(Qt::TextSingleLine | Qt::TextExpandTabs, text.left(column)).width();
+}
+
+void LargeFileViewer::updateScrollBars()
+{
+    int page = visibleLines();
+    verticalScrollBar()->setPageStep(page);
+    verticalScrollBar()->setRange(0, int(qMax<qint64>(0, table.lineCount() - page)));
+    horizontalScrollBar()->setPageStep(viewport()->width());
+    horizontalScrollBar()->setRange(0, qMax(0, textWidth - viewport()->width() + 6));
+}
+
+void LargeFileViewer::paintEvent(QPaintEvent*)
+{
+    TRACE_SCOPE("LargeFileViewer::paintEvent");
+    QPainter painter(viewport());
+    int height = fontMetrics().height();
+    int left = 3 - horizontalScrollBar()->value();
+    int width = textWidth;
+    qint64 line = verticalScrollBar()->value();
+
+    for (int top = 0; top < viewport()->height() && line < table.lineCount(); top += height, ++line)
+    {
+        if (line == current) painter.fillRect(0, top, viewport()->width(), height, QColor(Qt::yellow).lighter(180));
+        QVector<int> offsets;
+        QString text = lineText(line, line == current ? &offsets : nullptr);
+        int advance = fontMetrics().horizontalAdvance(text);
+        painter.drawText(left, top, advance + viewport()->width(), height,
+            Qt::AlignLeft | Qt::TextSingleLine | Qt::TextExpandTabs, text);
+        width = qMax(width, advance);
+
+        if (line == current && hasFocus())
+        {
+            int offset = int(qMin<qint64>(cursor - table.lineStart(line), INT_MAX));
+            int index = int(std::lower_bound(offsets.cbegin(), offsets.cend(), offset) - offsets.cbegin());
+            int x = left + columnX(text, qMin(index, int(text.size())));
+            painter.drawLine(x, top, x, top + height - 1);
+        }
+    }
+    if (width != textWidth)
+    {
+        textWidth = width;
+        QMetaObject::invokeMethod(this, [this]() { updateScrollBars(); }, Qt::QueuedConnection);
+    }
+}
+
+void LargeFileViewer::updateGutter()
+{
+    int width = lineNumberAreaWidth();
+    QRect rect = contentsRect();
+    setViewportMargins(width, 0, 0, 0);
+    lineNumberArea->setGeometry(QRect(rect.left(), rect.top(), width, rect.height()));
+}
+
+void LargeFileViewer::resizeEvent(QResizeEvent* event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateGutter();
+    updateScrollBars();
+}
+
+void LargeFileViewer::mousePressEvent(QMouseEvent* event)
+{
+    QPoint point = event->position().toPoint();
+    qint64 line = verticalScrollBar()->value() + point.y() / fontMetrics().height();
+    if (line >= table.lineCount()) line = table.lineCount() - 1;
+
+    QVector<int> offsets;
+    QString text = lineText(line, &offsets);
+    int x = point.x() - 3 + horizontalScrollBar()->value();
+    int first = 0;
+    int last = text.size();
+    while (first < last)
+    {
+        int middle = (first + last + 1) / 2;
+        if (columnX(text, middle) - fontMetrics().horizontalAdvance(text.at(middle - 1)) / 2 <= x) first = middle;
+        else last = middle - 1;
+    }
+    moveCursor(table.lineStart(line) + offsets.at(first));
+}
+
+void LargeFileViewer::moveCursor(qint64 position, bool keepColumn)
+{
+    cursor = qBound<qint64>(0, position, table.size());
+    current = table.lineOf(cursor);
+    if (!keepColumn) column = countChars(table.lineStart(current), cursor);
+    ensureCursorVisible();
+    viewport()->update();
+    emit currentLineChanged();
+}
+
+qint64 LargeFileViewer::nextChar(qint64 position) const
+{
+    if (position >= table.size()) return position;
+    if (table.at(position) == '\r' && table.at(position + 1) == '\n') return position + 2;
+    ++position;
+    while (position < table.size() && (uchar(table.at(position)) & 0xC0) == 0x80) ++position;
+    return position;
+}
+
+qint64 LargeFileViewer::previousChar(qint64 position) const
+{
+    if (position <= 0) return 0;
+    if (position >= 2 && table.at(position - 1) == '\n' && table.at(position - 2) == '\r') return position - 2;
+    --position;
+    while (position > 0 && (uchar(table.at(position)) & 0xC0) == 0x80) --position;
+    return position;
+}
+
+qint64 LargeFileViewer::positionInLine(qint64 line, int chars) const
+{
+    qint64 start = table.lineStart(line);
+    qint64 end = table.lineEnd(line);
+    if (end > start && table.at(end - 1) == '\r') --end;
+    for (qint64 position = start; position < end;)
+    {
+        QByteArray bytes = table.text(position, qMin<qint64>(end - position, PieceTable::maxPiece));
+        if (bytes.isEmpty()) break;
+        for (int i = 0; i < bytes.size(); ++i)
+        {
+            if (position + i != start && (uchar(bytes.at(i)) & 0xC0) == 0x80) continue;
+            if (chars-- == 0) return position + i;
+        }
+        position += bytes.size();
+    }
+    return end;
+}
+
+int LargeFileViewer::countChars(qint64 from, qint64 to) const
+{
+    int count = 0;
+    for (qint64 position = from; position < to;)
+    {
+        QByteArray bytes = table.text(position, qMin<qint64>(to - position, PieceTable::maxPiece));
+        if (bytes.isEmpty()) break;
+        for (int i = 0; i < bytes.size(); ++i)
+        {
+            if (position + i == from || (uchar(bytes.at(i)) & 0xC0) != 0x80) ++count;
+        }
+        position += bytes.size();
+    }
+    return count;
+}
+
+void LargeFileViewer::replace(qint64 position, qint64 length, const QByteArray& bytes, bool record)
+{
+    if (record)
+    {
+        undoStack.append({ position, table.text(position, length), bytes });
+        if (undoStack.size() > maxUndo) undoStack.remove(0, undoStack.size() - maxUndo);
+    }
+    table.remove(position, length);
+    table.insert(position, bytes);
+    ++changes;
+
+    int width = numberWidth;
+    if (lineNumberAreaWidth() != width) updateGutter();
+    updateScrollBars();
+    moveCursor(position + bytes.size());
+    lineNumberArea->update();
+    emit textChanged();
+}
+
+void LargeFileViewer::undo()
+{
+    if (undoStack.isEmpty()) return;
+    Edit edit = undoStack.takeLast();
+    replace(edit.position, edit.inserted.size(), edit.removed, false);
+}
+
+void LargeFileViewer::ensureCursorVisible()
+{
+    int first = verticalScrollBar()->value();
+    int page = visibleLines();
+    if (current < first) verticalScrollBar()->setValue(int(current));
+    else if (current >= first + page) verticalScrollBar()->setValue(int(current - page + 1));
+}
+
+void LargeFileViewer::copy()
+{
+    qint64 lineStart = table.lineStart(current);
+    qint64 lineEnd = table.lineEnd(current);
+    if (lineEnd > lineStart && table.at(lineEnd - 1) == '\r') --lineEnd;
+    QGuiApplication::clipboard()->setText(QString::fromUtf8(table.text(lineStart, lineEnd - lineStart)));
+}
+
+void LargeFileViewer::keyPressEvent(QKeyEvent* event)
+{
+    TRACE_SCOPE("LargeFileViewer::keyPressEvent");
+    bool control = event->modifiers() & Qt::ControlModifier;
+    qint64 lineStart = table.lineStart(current);
+    qint64 lineEnd = table.lineEnd(current);
+    if (lineEnd > lineStart && table.at(lineEnd - 1) == '\r') --lineEnd;
+
+    switch (event->key())
+    {
+    case Qt::Key_Left: moveCursor(previousChar(cursor)); return;
+    case Qt::Key_Right: moveCursor(nextChar(cursor)); return;
+    case Qt::Key_Up:
+        if (current > 0) moveCursor(positionInLine(current - 1, column), true);
+        return;
+    case Qt::Key_Down:
+        if (current + 1 < table.lineCount()) moveCursor(positionInLine(current + 1, column), true);
+        return;
+    case Qt::Key_PageUp: moveCursor(positionInLine(qMax<qint64>(0, current - visibleLines()), column), true); return;
+    case Qt::Key_PageDown: moveCursor(positionInLine(qMin(table.lineCount() - 1, current + visibleLines()), column), true); return;
+    case Qt::Key_Home: moveCursor(control ? 0 : lineStart); return;
+    case Qt::Key_End: moveCursor(control ? table.size() : lineEnd); return;
+    default: break;
+    }
+
+    if (event->matches(QKeySequence::Copy))
+    {
+        copy();
+        return;
+    }
+    if (indexing || saving) return;
+    if (event->matches(QKeySequence::Undo)) undo();
+    else if (event->matches(QKeySequence::Paste)) replace(cursor, 0, QGuiApplication::clipboard()->text().toUtf8());
+    else if (event->key() == Qt::Key_Backspace) replace(previousChar(cursor), cursor - previousChar(cursor), QByteArray());
+    else if (event->key() == Qt::Key_Delete) replace(cursor, nextChar(cursor) - cursor, QByteArray());
+    else if (event->key() == Qt::Key_Return || event->key() == Qt::Key_Enter) replace(cursor, 0, newline);
+    else if (!control && !event->text().isEmpty() && (event->text().at(0).isPrint() || event->text() == "\t"))
+        replace(cursor, 0, event->text().toUtf8());
+    else QAbstractScrollArea::keyPressEvent(event);
+}
+
+void LargeFileViewer::scrollContentsBy(int, int)
+{
+    viewport()->update();
+    lineNumberArea->update();
+}
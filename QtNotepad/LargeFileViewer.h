@@ -0,0 +1,84 @@
+#pragma once
+#include "NumberArea.h"
+#include "PieceTable.h"
+#include <QAbstractScrollArea>
+#include <QSharedPointer>
+#include <QByteArray>
+#include <QVector>
+
+struct IndexJob;
+
+class LargeFileViewer : public QAbstractScrollArea, public LineNumberSource
+{
+    Q_OBJECT
+public:
+    explicit LargeFileViewer(const QString&, QWidget* parent = nullptr);
+    ~LargeFileViewer();
+
+    bool open();
+    bool reload();
+    void release();
+    bool restore();
+    void setSaving(bool);
+    QString path() const;
+    qint64 lineCount() const;
+    qint64 currentLine() const;
+    qint64 memoryUsage() const;
+    int revision() const;
+    PieceTable snapshot() const;
+    void goToLine(qint64);
+    void copy();
+
+    void lineNumberAreaPaintEvent(QPaintEvent*) override;
+    int lineNumberAreaWidth() override;
+
+signals:
+    void currentLineChanged();
+    void textChanged();
+
+protected:
+    void paintEvent(QPaintEvent*) override;
+    void resizeEvent(QResizeEvent*) override;
+    void mousePressEvent(QMouseEvent*) override;
+    void keyPressEvent(QKeyEvent*) override;
+    void scrollContentsBy(int, int) override;
+
+private:
+    struct Edit
+    {
+        qint64 position;
+        QByteArray removed;
+        QByteArray inserted;
+    };
+
+    void appendPieces(const QVector<qint64>&, bool);
+    void updateScrollBars();
+    void updateGutter();
+    QString lineText(qint64, QVector<int>* offsets = nullptr) const;
+    int visibleLines() const;
+    int columnX(const QString&, int) const;
+
+    void moveCursor(qint64, bool keepColumn = false);
+    qint64 nextChar(qint64) const;
+    qint64 previousChar(qint64) const;
+    qint64 positionInLine(qint64, int) const;
+    int countChars(qint64, qint64) const;
+    void replace(qint64, qint64, const QByteArray&, bool record = true);
+    void undo();
+    void ensureCursorVisible();
+
+    QString filePath;
+    PieceTable table;
+    QWidget* lineNumberArea;
+    QSharedPointer<IndexJob> job;
+    QVector<Edit> undoStack;
+    QByteArray newline;
+    qint64 cursor;
+    qint64 current;
+    int column;
+    int changes;
+    int numberWidth;
+    int textWidth;
+    bool indexing;
+    bool saving;
+};
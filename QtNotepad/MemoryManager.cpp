@@ -0,0 +1,80 @@
+#include "MemoryManager.h"
+#include "Editor.h"
+#include "LargeFileViewer.h"
+#include "TabPlaceholder.h"
+#include <algorithm>
+
+static const qint64 blockOverhead = 120;
+
+MemoryManager::MemoryManager(QObject* parent) : QObject(parent), limit(512 * 1024 * 1024), coldAfter(120000)
+{
+    clock.start();
+}
+
+void MemoryManager::setBudget(qint64 bytes)
+{
+    limit = bytes;
+}
+
+qint64 MemoryManager::budget() const
+{
+    return limit;
+}
+
+void MemoryManager::setColdAfter(qint64 msecs)
+{
+    coldAfter = msecs;
+}
+
+void MemoryManager::touch(QWidget* page)
+{
+    if (page) lastAccess.insert(page, clock.elapsed());
+}
+
+void MemoryManager::forget(QWidget* page)
+{
+    lastAccess.remove(page);
+}
+
+qint64 MemoryManager::footprint(QWidget* page)
+{
+    if (Editor* editor = qobject_cast<Editor*>(page))
+        return editor->document()->characterCount() * qint64(sizeof(QChar)) + editor->document()->blockCount() * blockOverhead;
+    if (LargeFileViewer* viewer = qobject_cast<LargeFileViewer*>(page)) return viewer->memoryUsage();
+    if (TabPlaceholder* placeholder = qobject_cast<TabPlaceholder*>(page)) return placeholder->memoryUsage();
+    return 0;
+}
+
+qint64 MemoryManager::usage(const QList<QWidget*>& pages) const
+{
+    qint64 total = 0;
+    for (QWidget* page : pages) total += footprint(page);
+    return total;
+}
+
+QList<QWidget*> MemoryManager::coldPages(const QList<QWidget*>& pages, QWidget* current) const
+{
+    qint64 total = usage(pages);
+    if (total <= limit) return QList<QWidget*>();
+
+    qint64 now = clock.elapsed();
+    QList<QWidget*> candidates;
+    for (QWidget* page : pages)
+    {
+        if (page == current || qobject_cast<TabPlaceholder*>(page)) continue;
+        if (now - lastAccess.value(page, 0) >= coldAfter) candidates.append(page);
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](QWidget* a, QWidget* b)
+    {
+        return lastAccess.value(a, 0) < lastAccess.value(b, 0);
+    });
+
+    QList<QWidget*> evicted;
+    for (QWidget* page : candidates)
+    {
+        if (total <= limit) break;
+        total -= footprint(page);
+        evicted.append(page);
+    }
+    return evicted;
+}
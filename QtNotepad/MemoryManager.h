@@ -0,0 +1,30 @@
+#pragma once
+#include <QObject>
+#include <QWidget>
+#include <QHash>
+#include <QList>
+#include <QElapsedTimer>
+
+class MemoryManager : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MemoryManager(QObject* parent = nullptr);
+
+    void setBudget(qint64);
+    qint64 budget() const;
+    void setColdAfter(qint64);
+
+    void touch(QWidget*);
+    void forget(QWidget*);
+
+    static qint64 footprint(QWidget*);
+    qint64 usage(const QList<QWidget*>&) const;
+    QList<QWidget*> coldPages(const QList<QWidget*>&, QWidget*) const;
+
+private:
+    QElapsedTimer clock;
+    QHash<QWidget*, qint64> lastAccess;
+    qint64 limit;
+    qint64 coldAfter;
+};
@@ -1,12 +1,12 @@
 #include "NumberArea.h"
-NumberArea::NumberArea(Editor* parent) : QWidget(parent), editor(parent){}
+NumberArea::NumberArea(QWidget* parent, LineNumberSource* numbers) : QWidget(parent), source(numbers){}
 
 QSize NumberArea::sizeHint() const
 {
-    return QSize(editor->lineNumberAreaWidth(), 0);
+    return QSize(source->lineNumberAreaWidth(), 0);
 }
 
 void NumberArea::paintEvent(QPaintEvent* event)
 {
-    editor->lineNumberAreaPaintEvent(event);
+    source->lineNumberAreaPaintEvent(event);
 }
\ No newline at end of file
@@ -1,15 +1,22 @@
 #pragma once
-#include "editor.h"
+#include <QWidget>
+#include <QPaintEvent>
 
+class LineNumberSource
+{
+public:
+    virtual ~LineNumberSource() = default;
+    virtual int lineNumberAreaWidth() = 0;
+    virtual void lineNumberAreaPaintEvent(QPaintEvent*) = 0;
+};
 
 class NumberArea : public QWidget
 {
-    Editor* editor;
+    LineNumberSource* source;
 public:
-    NumberArea(Editor*);
+    NumberArea(QWidget*, LineNumberSource*);
     QSize sizeHint() const override;
 
 protected:
     void paintEvent(QPaintEvent* event) override;
 };
-
@@ -0,0 +1,369 @@
+#include "PieceTable.h"
+#include <QIODevice>
+#include <algorithm>
+#include <cstring>
+
+PieceTable::PieceTable() : original(nullptr), root(-1), seed(2463534242u)
+{
+}
+
+bool PieceTable::map(const QString& path)
+{
+    clear();
+    return attach(path);
+}
+
+bool PieceTable::attach(const QString& path)
+{
+    QSharedPointer<QFile> source(new QFile(path));
+    if (!source->open(QIODevice::ReadOnly)) return false;
+    if (source->size() > 0)
+    {
+        original = reinterpret_cast<const char*>(source->map(0, source->size()));
+        if (!original) return false;
+    }
+    file = source;
+    return true;
+}
+
+void PieceTable::detach()
+{
+    file.reset();
+    original = nullptr;
+}
+
+void PieceTable::clear()
+{
+    detach();
+    added.clear();
+    nodes.clear();
+    freeNodes.clear();
+    root = -1;
+}
+
+const char* PieceTable::data(Source source) const
+{
+    return source == Original ? original : added.constData();
+}
+
+int PieceTable::createNode(Source source, qint64 start, qint64 length, qint64 lineFeeds)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    Node node;
+    node.left = -1;
+    node.right = -1;
+    node.priority = seed;
+    node.source = source;
+    node.start = start;
+    node.length = length;
+    node.lineFeeds = lineFeeds < 0 ? countLineFeeds(source, start, length) : lineFeeds;
+
+    int index;
+    if (freeNodes.isEmpty())
+    {
+        index = nodes.size();
+        nodes.append(node);
+    }
+    else
+    {
+        index = freeNodes.takeLast();
+        nodes[index] = node;
+    }
+    update(index);
+    return index;
+}
+
+void PieceTable::releaseTree(int t)
+{
+    if (t < 0) return;
+    releaseTree(nodes[t].left);
+    releaseTree(nodes[t].right);
+    freeNodes.append(t);
+}
+
+qint64 PieceTable::totalLength(int t) const
+{
+    return t < 0 ? 0 : nodes[t].totalLength;
+}
+
+qint64 PieceTable::totalLineFeeds(int t) const
+{
+    return t < 0 ? 0 : nodes[t].totalLineFeeds;
+}
+
+void PieceTable::update(int t)
+{
+    Node& node = nodes[t];
+    node.totalLength = totalLength(node.left) + node.length + totalLength(node.right);
+    node.totalLineFeeds = totalLineFeeds(node.left) + node.lineFeeds + totalLineFeeds(node.right);
+}
+
+qint64 PieceTable::countLineFeeds(Source source, qint64 start, qint64 length) const
+{
+    const char* begin = data(source) + start;
+    return std::count(begin, begin + length, '\n');
+}
+
+int PieceTable::merge(int a, int b)
+{
+    if (a < 0) return b;
+    if (b < 0) return a;
+    if (nodes[a].priority > nodes[b].priority)
+    {
+        int right = merge(nodes[a].right, b);
+        nodes[a].right = right;
+        update(a);
+        return a;
+    }
+    int left = merge(a, nodes[b].left);
+    nodes[b].left = left;
+    update(b);
+    return b;
+}
+
+void PieceTable::split(int t, qint64 position, int& left, int& right)
+{
+    if (t < 0)
+    {
+        left = right = -1;
+        return;
+    }
+
+    qint64 leftLength = totalLength(nodes[t].left);
+    if (position <= leftLength)
+    {
+        int inner;
+        split(nodes[t].left, position, left, inner);
+        nodes[t].left = inner;
+        update(t);
+        right = t;
+        return;
+    }
+    if (position >= leftLength + nodes[t].length)
+    {
+        int inner;
+        split(nodes[t].right, position - leftLength - nodes[t].length, inner, right);
+        nodes[t].right = inner;
+        update(t);
+        left = t;
+        return;
+    }
+
+    qint64 cut = position - leftLength;
+    int tail = createNode(nodes[t].source, nodes[t].start + cut, nodes[t].length - cut);
+    int rest = nodes[t].right;
+    nodes[t].length = cut;
+    nodes[t].lineFeeds -= nodes[tail].lineFeeds;
+    nodes[t].right = -1;
+    update(t);
+    left = t;
+    right = merge(tail, rest);
+}
+
+bool PieceTable::extendLast(int t, qint64 length, qint64 lineFeeds)
+{
+    if (t < 0) return false;
+    if (nodes[t].right >= 0)
+    {
+        if (!extendLast(nodes[t].right, length, lineFeeds)) return false;
+    }
+    else
+    {
+        Node& node = nodes[t];
+        if (node.source != Added || node.start + node.length != added.size() - length || node.length + length > maxPiece)
+            return false;
+        node.length += length;
+        node.lineFeeds += lineFeeds;
+    }
+    update(t);
+    return true;
+}
+
+int PieceTable::buildPieces(qint64 start, qint64 length)
+{
+    int tree = -1;
+    for (qint64 offset = 0; offset < length; offset += maxPiece)
+        tree = merge(tree, createNode(Added, start + offset, qMin(maxPiece, length - offset)));
+    return tree;
+}
+
+void PieceTable::appendOriginal(qint64 start, qint64 length, qint64 lineFeeds)
+{
+    root = merge(root, createNode(Original, start, length, lineFeeds));
+}
+
+qint64 PieceTable::size() const
+{
+    return totalLength(root);
+}
+
+qint64 PieceTable::lineCount() const
+{
+    return totalLineFeeds(root) + 1;
+}
+
+qint64 PieceTable::lineStart(qint64 line) const
+{
+    if (line <= 0) return 0;
+    if (line >= lineCount()) return size();
+
+    qint64 offset = 0;
+    int t = root;
+    while (t >= 0)
+    {
+        const Node& node = nodes[t];
+        qint64 leftFeeds = totalLineFeeds(node.left);
+        if (line <= leftFeeds)
+        {
+            t = node.left;
+            continue;
+        }
+        offset += totalLength(node.left);
+        line -= leftFeeds;
+        if (line <= node.lineFeeds)
+        {
+            const char* begin = data(node.source) + node.start;
+            const char* p = begin;
+            while (true)
+            {
+                p = static_cast<const char*>(memchr(p, '\n', size_t(begin + node.length - p))) + 1;
+                if (--line == 0) return offset + (p - begin);
+            }
+        }
+        offset += node.length;
+        line -= node.lineFeeds;
+        t = node.right;
+    }
+    return size();
+}
+
+qint64 PieceTable::lineEnd(qint64 line) const
+{
+    if (line + 1 >= lineCount()) return size();
+    return lineStart(line + 1) - 1;
+}
+
+qint64 PieceTable::lineOf(qint64 position) const
+{
+    qint64 line = 0;
+    int t = root;
+    while (t >= 0)
+    {
+        const Node& node = nodes[t];
+        qint64 leftLength = totalLength(node.left);
+        if (position < leftLength)
+        {
+            t = node.left;
+            continue;
+        }
+        line += totalLineFeeds(node.left);
+        position -= leftLength;
+        if (position < node.length) return line + countLineFeeds(node.source, node.start, position);
+        line += node.lineFeeds;
+        position -= node.length;
+        t = node.right;
+    }
+    return line;
+}
+
+void PieceTable::collect(int t, qint64 offset, qint64 from, qint64 to, QByteArray& result) const
+{
+    if (t < 0) return;
+    const Node& node = nodes[t];
+    qint64 start = offset + totalLength(node.left);
+    qint64 end = start + node.length;
+    if (from < start) collect(node.left, offset, from, to, result);
+    if (from < end && to > start)
+    {
+        qint64 first = qMax(from, start) - start;
+        qint64 last = qMin(to, end) - start;
+        result.append(data(node.source) + node.start + first, last - first);
+    }
+    if (to > end) collect(node.right, end, from, to, result);
+}
+
+QByteArray PieceTable::text(qint64 position, qint64 length) const
+{
+    QByteArray result;
+    length = qMin(length, size() - position);
+    if (length <= 0) return result;
+    result.reserve(length);
+    collect(root, 0, position, position + length, result);
+    return result;
+}
+
+char PieceTable::at(qint64 position) const
+{
+    int t = root;
+    while (t >= 0)
+    {
+        const Node& node = nodes[t];
+        qint64 leftLength = totalLength(node.left);
+        if (position < leftLength) t = node.left;
+        else if (position < leftLength + node.length) return data(node.source)[node.start + position - leftLength];
+        else
+        {
+            position -= leftLength + node.length;
+            t = node.right;
+        }
+    }
+    return 0;
+}
+
+void PieceTable::insert(qint64 position, const QByteArray& bytes)
+{
+    if (bytes.isEmpty()) return;
+    qint64 start = added.size();
+    added.append(bytes);
+
+    int left;
+    int right;
+    split(root, position, left, right);
+    if (!extendLast(left, bytes.size(), std::count(bytes.cbegin(), bytes.cend(), '\n')))
+        left = merge(left, buildPieces(start, bytes.size()));
+    root = merge(left, right);
+}
+
+void PieceTable::remove(qint64 position, qint64 length)
+{
+    if (length <= 0) return;
+    int left;
+    int middle;
+    int right;
+    split(root, position, left, right);
+    split(right, length, middle, right);
+    releaseTree(middle);
+    root = merge(left, right);
+}
+
+bool PieceTable::write(QIODevice* device) const
+{
+    QVector<int> stack;
+    int t = root;
+    while (t >= 0 || !stack.isEmpty())
+    {
+        while (t >= 0)
+        {
+            stack.append(t);
+            t = nodes[t].left;
+        }
+        t = stack.takeLast();
+        const Node& node = nodes[t];
+        if (device->write(data(node.source) + node.start, node.length) != node.length) return false;
+        t = node.right;
+    }
+    return true;
+}
+
+qint64 PieceTable::pieceCount() const
+{
+    return nodes.size() - freeNodes.size();
+}
+
+qint64 PieceTable::memoryUsage() const
+{
+    return nodes.capacity() * qint64(sizeof(Node)) + freeNodes.capacity() * qint64(sizeof(int)) + added.capacity();
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QVector>
+#include <QFile>
+#include <QtGlobal>
+
+class QIODevice;
+
+class PieceTable
+{
+public:
+    PieceTable();
+
+    bool map(const QString&);
+    bool attach(const QString&);
+    void detach();
+    void clear();
+    void appendOriginal(qint64, qint64, qint64);
+
+    qint64 size() const;
+    qint64 lineCount() const;
+    qint64 lineStart(qint64) const;
+    qint64 lineEnd(qint64) const;
+    qint64 lineOf(qint64) const;
+    QByteArray text(qint64, qint64) const;
+    char at(qint64) const;
+
+    void insert(qint64, const QByteArray&);
+    void remove(qint64, qint64);
+
+    bool write(QIODevice*) const;
+    qint64 pieceCount() const;
+    qint64 memoryUsage() const;
+
+    static constexpr qint64 maxPiece = 1 << 16;
+
+private:
+    enum Source { Original, Added };
+
+    struct Node
+    {
+        int left;
+        int right;
+        quint32 priority;
+        Source source;
+        qint64 start;
+        qint64 length;
+        qint64 lineFeeds;
+        qint64 totalLength;
+        qint64 totalLineFeeds;
+    };
+
+    const char* data(Source) const;
+    int createNode(Source, qint64, qint64, qint64 lineFeeds = -1);
+    void releaseTree(int);
+    void update(int);
+    qint64 totalLength(int) const;
+    qint64 totalLineFeeds(int) const;
+    qint64 countLineFeeds(Source, qint64, qint64) const;
+    int merge(int, int);
+    void split(int, qint64, int&, int&);
+    bool extendLast(int, qint64, qint64);
+    int buildPieces(qint64, qint64);
+    void collect(int, qint64, qint64, qint64, QByteArray&) const;
+
+    QSharedPointer<QFile> file;
+    const char* original;
+    QByteArray added;
+    QVector<Node> nodes;
+    QVector<int> freeNodes;
+    int root;
+    quint32 seed;
+};
@@ -1,36 +1,74 @@
 #include "QtNotepad.h"
+#include "Trace.h"
 
-QtNotepad::QtNotepad(QWidget * parent) : QMainWindow(parent)
+QtNotepad::QtNotepad(QWidget * parent, bool session) : QMainWindow(parent)
 {
     menu = nullptr;
     fileIndex = 1;
+    restoring = false;
+    loading = false;
+    saver = new FileSaver(this);
+    connect(saver, SIGNAL(saved(quint64, QString, int)), SLOT(fileSaved(quint64, QString, int)));
+    connect(saver, SIGNAL(failed(quint64, QString, QString)), SLOT(fileSaveFailed(quint64, QString, QString)));
+    connect(saver, SIGNAL(aboutToReplace(quint64, QString)), SLOT(releaseFile(quint64)));
+    connect(saver, SIGNAL(unencodable(quint64, QString)), SLOT(fileUnencodable(quint64, QString)));
+    memory = new MemoryManager(this);
+    documents = new DocumentRegistry(this);
+    connect(documents, &DocumentRegistry::changed, this, &QtNotepad::documentChanged);
+    findDialog = nullptr;
+    ruleProfile = nullptr;
+    workspaceIndex = nullptr;
+    quickOpen = nullptr;
+    searchPending = 0;
+    searchTotal = 0;
+    searchTabs = 0;
+    watcher = new QFileSystemWatcher(this);
+    reloadTimer = new QTimer(this);
+    reloadTimer->setSingleShot(true);
+    reloadTimer->setInterval(300);
+    connect(watcher, SIGNAL(fileChanged(QString)), SLOT(fileChangedOnDisk(QString)));
+    connect(reloadTimer, SIGNAL(timeout()), SLOT(reloadChangedFiles()));
+    cursorTimer = new QTimer(this);
+    cursorTimer->setSingleShot(true);
+    cursorTimer->setInterval(0);
+    connect(cursorTimer, &QTimer::timeout, this, &QtNotepad::cursorChange);
+    search = new SearchEngine(this);
+    connect(search, &SearchEngine::found, this, &QtNotepad::searchFound);
+    connect(search, &SearchEngine::finished, this, &QtNotepad::searchFinished);
+    connect(search, &SearchEngine::replaced, this, &QtNotepad::searchReplaced);
+    memoryTimer = new QTimer(this);
+    connect(memoryTimer, SIGNAL(timeout()), SLOT(hibernateTabs()));
     setWindowIcon(QIcon(":/images/icon.ico"));
     setWindowTitle("QtNotepad");
     resize(800, 600);
     makeTabWidget();
     makeFileExplorerDock();
+    makeFindInFilesDock();
     makeOpenedFilesDock();
     makeActions();
     makeMenuBar();
     makeToolBar();
     setCentralWidget(tabWgt);
     label = new QLabel(this);
+    statsLabel = new QLabel(this);
+    memoryLabel = new QLabel(this);
+    undoLabel = new QLabel(this);
+    undoBudget = 32 * 1024 * 1024;
     statusBar()->addPermanentWidget(label);
-    loadSettings();
+    statusBar()->addPermanentWidget(statsLabel);
+    statusBar()->addPermanentWidget(undoLabel);
+    statusBar()->addPermanentWidget(memoryLabel);
+    if (session) loadSettings();
 }
 
 void QtNotepad::closeEvent(QCloseEvent* event)
 {
-    bool flag = false;
-    for (int i = 0; i < tabWgt->count(); ++i)
+    if (loading)
     {
-        if (tabWgt->tabWhatsThis(i) != "Without changes")
-        {
-            flag = true;
-            break;
-        }
+        event->ignore();
+        return;
     }
-    if (flag)
+    if (documents->hasDirty())
     {
         SaveDialog* dialog = createDialog();
         dialog->setModal(true);
@@ -42,6 +80,11 @@ void QtNotepad::closeEvent(QCloseEvent* event)
         event->accept();
         delete dialog;
     }
+    saver->waitForDone();
+    QCoreApplication::sendPostedEvents(saver, QEvent::MetaCall);
+    const QList<EditJournal*> journals = findChildren<EditJournal*>();
+    for (EditJournal* journal : journals) journal->discard();
+    EditJournal::waitForWrites();
     saveSettings();
 }
 
@@ -53,6 +96,7 @@ void QtNotepad::makeTabWidget()
     tabWgt->setUsesScrollButtons(true);
     tabWgt->setMovable(true);
     connect(tabWgt, SIGNAL(tabCloseRequested(int)), this, SLOT(closeFile(int)));
+    connect(tabWgt, SIGNAL(currentChanged(int)), this, SLOT(materializeTab(int)));
 }
 
 void QtNotepad::makeActions()
@@ -93,6 +137,8 @@ void QtNotepad::makeMenuBar()
 
     fileMenu->addAction(create);
     fileMenu->addAction(open);
+    fileMenu->addAction(tr("Open folder"), this, SLOT(openFolder()));
+    fileMenu->addAction(tr("Go to file"), this, SLOT(showQuickOpen()), QKeySequence("CTRL+P"));
     fileMenu->addAction(save);
     fileMenu->addAction(saveAs);
     fileMenu->addAction(saveAll);
@@ -100,14 +146,26 @@ void QtNotepad::makeMenuBar()
     fileMenu->addAction(closeAll);
     fileMenu->addAction(exit);
 
+    editMenu->addAction(tr("Undo"), this, SLOT(undo()), QKeySequence("CTRL+Z"));
+    editMenu->addAction(tr("Redo"), this, SLOT(redo()), QKeySequence("CTRL+Y"));
+    editMenu->addSeparator();
     editMenu->addAction(tr("Cut"), this, SLOT(cut()), QKeySequence("CTRL+X"));
     editMenu->addAction(tr("Copy"), this, SLOT(copy()), QKeySequence("CTRL+C"));
     editMenu->addAction(tr("Paste"), this, SLOT(paste()), QKeySequence("CTRL+V"));
     editMenu->addAction(tr("Delete"), this, SLOT(clear()), QKeySequence("CTRL+DELETE"));
     editMenu->addAction(tr("Select all"), this, SLOT(selectAll()), QKeySequence("CTRL+A"));
+    editMenu->addSeparator();
+    editMenu->addAction(tr("Find"), this, SLOT(showFind()), QKeySequence("CTRL+F"));
+    editMenu->addAction(tr("Find next"), this, SLOT(findNext()), QKeySequence("F3"));
+    editMenu->addAction(tr("Find previous"), this, SLOT(findPrevious()), QKeySequence("SHIFT+F3"));
+    editMenu->addAction(tr("Replace"), this, SLOT(showReplace()), QKeySequence("CTRL+H"));
+    editMenu->addAction(tr("Find in files"), this, SLOT(showFindInFiles()), QKeySequence("CTRL+SHIFT+F"));
 
     viewMenu->addAction(fileExplorer->toggleViewAction());
+    viewMenu->addAction(findInFilesDock->toggleViewAction());
     viewMenu->addAction(openedFiles->toggleViewAction());
+    viewMenu->addSeparator();
+    viewMenu->addAction(tr("Highlighting profile"), this, SLOT(showRuleProfile()));
 
     menuBar()->addMenu(fileMenu);
     menuBar()->addMenu(editMenu);
@@ -125,15 +183,10 @@ void QtNotepad::makeToolBar()
 
 void QtNotepad::makeFileExplorerDock()
 {
-    filesModel = new QFileSystemModel(this);
-    filesModel->setRootPath(QDir::rootPath());
-
+    filesModel = nullptr;
     tree = new QTreeView(this);
-    tree->setModel(filesModel);
-    tree->setColumnHidden(1, true);
-    tree->setColumnHidden(2, true);
-    tree->setColumnHidden(3, true);
     tree->setHeaderHidden(true);
+    tree->setUniformRowHeights(true);
     connect(tree, SIGNAL(doubleClicked(QModelIndex)), SLOT(openFile(QModelIndex)));
 
     fileExplorer = new QDockWidget(tr("Explorer"), this);
@@ -141,9 +194,96 @@ void QtNotepad::makeFileExplorerDock()
     fileExplorer->setMaximumWidth(700);
     fileExplorer->setFeatures(QDockWidget::DockWidgetClosable | QDockWidget::DockWidgetMovable);
     fileExplorer->hide();
+    connect(fileExplorer, SIGNAL(visibilityChanged(bool)), SLOT(showExplorer(bool)));
     addDockWidget(Qt::LeftDockWidgetArea, fileExplorer);
 }
 
+void QtNotepad::showExplorer(bool visible)
+{
+    if (!visible || filesModel) return;
+    QSettings settings("Company", "QtNotepad");
+    filesModel = new ExplorerModel(this);
+    filesModel->setIgnorePatterns(ignorePatterns());
+    filesModel->setLimits(settings.value("ExplorerMaxEntries", 20000).toInt(), settings.value("ExplorerMaxWatches", 256).toInt());
+    filesModel->setRootPath(workspaceRoot());
+    tree->setModel(filesModel);
+    connect(tree, &QTreeView::collapsed, filesModel, &ExplorerModel::release);
+}
+
+QString QtNotepad::workspaceRoot()
+{
+    QString root = QDir::currentPath();
+    if (QDir(root).isRoot()) root = QDir::homePath();
+    return QSettings("Company", "QtNotepad").value("WorkspaceRoot", root).toString();
+}
+
+QStringList QtNotepad::ignorePatterns()
+{
+    return QSettings("Company", "QtNotepad").value("ExplorerIgnore", QStringList{ ".git/", ".svn/", ".hg/", "node_modules/" }).toStringList();
+}
+
+void QtNotepad::showQuickOpen()
+{
+    if (!workspaceIndex)
+    {
+        QSettings settings("Company", "QtNotepad");
+        workspaceIndex = new FileIndex(this);
+        workspaceIndex->setIgnorePatterns(ignorePatterns());
+        workspaceIndex->setMaxWatches(settings.value("QuickOpenMaxWatches", 1024).toInt());
+        workspaceIndex->setCacheEnabled(settings.value("QuickOpenCache", true).toBool());
+        workspaceIndex->setRoot(workspaceRoot());
+        quickOpen = new QuickOpenDialog(workspaceIndex, this);
+        connect(quickOpen, SIGNAL(fileChosen(QString)), SLOT(openFile(QString)));
+    }
+    quickOpen->popup();
+}
+
+void QtNotepad::openFolder()
+{
+    QString path = QFileDialog::getExistingDirectory(this, tr("Open folder"), workspaceRoot());
+    if (path.isEmpty()) return;
+
+    QSettings("Company", "QtNotepad").setValue("WorkspaceRoot", path);
+    if (workspaceIndex) workspaceIndex->setRoot(path);
+    if (filesModel) filesModel->setRootPath(path);
+    else showExplorer(true);
+    fileExplorer->show();
+    fileExplorer->raise();
+}
+
+void QtNotepad::makeFindInFilesDock()
+{
+    fileSearch = new FileSearch(this);
+    connect(fileSearch, &FileSearch::found, this, &QtNotepad::filesFound);
+    connect(fileSearch, &FileSearch::finished, this, &QtNotepad::filesFinished);
+
+    filesPattern = new QLineEdit;
+    filesCase = new QCheckBox(tr("Match case"));
+    filesRegex = new QCheckBox(tr("Regular expression"));
+    filesStatus = new QLabel;
+    filesResults = new QListWidget;
+    QPushButton* btnFind = new QPushButton(tr("Find"));
+    connect(btnFind, SIGNAL(clicked()), SLOT(findInFiles()));
+    connect(filesPattern, SIGNAL(returnPressed()), SLOT(findInFiles()));
+    connect(filesResults, SIGNAL(itemActivated(QListWidgetItem*)), SLOT(openHit(QListWidgetItem*)));
+    connect(filesResults, SIGNAL(itemClicked(QListWidgetItem*)), SLOT(openHit(QListWidgetItem*)));
+
+    QWidget* panel = new QWidget;
+    QGridLayout* layout = new QGridLayout(panel);
+    layout->addWidget(filesPattern, 0, 0, 1, 2);
+    layout->addWidget(btnFind, 0, 2);
+    layout->addWidget(filesCase, 1, 0);
+    layout->addWidget(filesRegex, 1, 1);
+    layout->addWidget(filesStatus, 2, 0, 1, 3);
+    layout->addWidget(filesResults, 3, 0, 1, 3);
+
+    findInFilesDock = new QDockWidget(tr("Find in files"), this);
+    findInFilesDock->setWidget(panel);
+    findInFilesDock->setFeatures(QDockWidget::DockWidgetClosable | QDockWidget::DockWidgetMovable);
+    findInFilesDock->hide();
+    addDockWidget(Qt::BottomDockWidgetArea, findInFilesDock);
+}
+
 void QtNotepad::makeOpenedFilesDock()
 {
     currFiles = new QListWidget(this);
@@ -151,7 +291,6 @@ void QtNotepad::makeOpenedFilesDock()
     connect(tabWgt->tabBar(), SIGNAL(tabMoved(int, int)), SLOT(changeTabIndex(int, int)));
     connect(tabWgt->tabBar(), SIGNAL(currentChanged(int)), SLOT(changeCurrIndex(int)));
     connect(tabWgt->tabBar(), SIGNAL(tabCloseRequested(int)), SLOT(changeIndexOnDelete()));
-    connect(tabWgt->tabBar(), SIGNAL(tabMoved(int, int)), SLOT(changeContainers(int, int)));
     connect(currFiles, SIGNAL(itemClicked(QListWidgetItem*)), SLOT(changeCurrIndex(QListWidgetItem*)));
     connect(currFiles, SIGNAL(currentRowChanged(int)), tabWgt, SLOT(setCurrentIndex(int)));
 
@@ -164,27 +303,22 @@ void QtNotepad::makeOpenedFilesDock()
 
 void QtNotepad::createFile()
 {
+    TRACE_SCOPE("QtNotepad::createFile");
     Editor* editor = new Editor(this);
     QString name = "Unnamed" + QString::number(fileIndex);
 
-    int index = tabWgt->addTab(editor, name);
+    int index = addDocument(editor, "", name);
     tabWgt->setCurrentIndex(index);
-    tabWgt->setTabToolTip(index, "");
-    tabWgt->setTabWhatsThis(index, "Without changes");
+    editor->undoHistory()->setBudget(undoBudget);
+    editor->contentHash()->markSaved();
+    editor->journal()->setSource("", name);
     connect(editor, SIGNAL(textChanged()), SLOT(changeParameter()));
-
-    QListWidgetItem* item = new QListWidgetItem;
-    item->setText(tabWgt->tabText(index));
-    item->setToolTip(tabWgt->tabToolTip(index));
-
-    currFiles->addItem(item);
     changeCurrIndex(index);
-
-    filepaths.push_back(QDir::current());
-    filenames.push_back(name);
     fileIndex++;
 
-    connect(editor, &Editor::cursorPositionChanged, this, &QtNotepad::statusBarChange);
+    connect(editor, SIGNAL(cursorPositionChanged()), cursorTimer, SLOT(start()));
+    connect(editor, SIGNAL(selectionChanged()), cursorTimer, SLOT(start()));
+    connect(editor, SIGNAL(textChanged()), cursorTimer, SLOT(start()));
 }
 
 void QtNotepad::openFile()
@@ -200,130 +334,356 @@ void QtNotepad::openFile()
 
 void QtNotepad::openFile(QModelIndex index)
 {
-    if (!filesModel->isDir(index)) openFile(filesModel->filePath(index));
+    if (!filesModel || filesModel->isDir(index)) return;
+    QString path = filesModel->filePath(index);
+    if (!path.isEmpty()) openFile(path);
 }
 
 void QtNotepad::openFile(const QString& path)
 {
-    for (int i = 0; i < tabWgt->count(); ++i)
+    TRACE_SCOPE("QtNotepad::openFile");
+    if (loading) return;
+    if (documents->find(path))
     {
-        if (tabWgt->tabToolTip(i) == path)
-        {
-            QMessageBox::warning(this, tr("Error"), tr("The file is already open!"), QMessageBox::Ok);
-            return;
-        }
+        QMessageBox::warning(this, tr("Error"), tr("The file is already open!"), QMessageBox::Ok);
+        return;
     }
 
+    QWidget* page = createPage(path);
+    if (!page) return;
+
+    int index = addDocument(page, path, path.section("/", -1, -1));
+    tabWgt->setCurrentIndex(index);
+    tabWgt->repaint();
+    changeCurrIndex(index);
+    updateWatches();
+}
+
+int QtNotepad::addDocument(QWidget* page, const QString& path, const QString& name, bool dirty)
+{
+    quint64 id = documents->add(page, path, name, dirty);
+    int index = tabWgt->addTab(page, documents->title(id));
+    tabWgt->setTabToolTip(index, path);
+    QListWidgetItem* item = new QListWidgetItem;
+    item->setText(documents->title(id));
+    item->setToolTip(path);
+    currFiles->addItem(item);
+    return index;
+}
+
+void QtNotepad::documentChanged(quint64 id)
+{
+    int index = tabWgt->indexOf(documents->page(id));
+    if (index < 0) return;
+    tabWgt->setTabText(index, documents->title(id));
+    tabWgt->setTabToolTip(index, documents->path(id));
+    if (QListWidgetItem* item = currFiles->item(index))
+    {
+        item->setText(documents->title(id));
+        item->setToolTip(documents->path(id));
+    }
+}
+
+QWidget* QtNotepad::createPage(const QString& path, TabPlaceholder* placeholder)
+{
+    TRACE_SCOPE("QtNotepad::createPage");
     QString name = path.section("/", -1, -1);
-    QFile file(path);
+    QSettings settings("Company", "QtNotepad");
+    qint64 threshold = settings.value("LargeFileThreshold", 128).toLongLong() * 1024 * 1024;
+
+    bool hibernated = placeholder && placeholder->hasSnapshot();
 
-    if (file.open(QIODevice::ReadOnly))
+    if (!hibernated && QFileInfo(path).size() > threshold)
     {
-        filepaths.push_back(QFileInfo(file).path());
-        filenames.push_back(name);
+        LargeFileViewer* viewer = new LargeFileViewer(path, this);
+        if (!viewer->open())
+        {
+            delete viewer;
+            QMessageBox::warning(this, tr("Error"), tr("Can't open the file!"), QMessageBox::Ok);
+            return nullptr;
+        }
+        connect(viewer, SIGNAL(currentLineChanged()), cursorTimer, SLOT(start()));
+        connect(viewer, SIGNAL(textChanged()), SLOT(changeParameter()));
+        return viewer;
+    }
 
-        Editor* tmp = new Editor(this);
-        QString buffer = file.readAll();
-        QString extension = QFileInfo(name).suffix();
+    Editor* tmp = new Editor(this);
+    if (hibernated)
+    {
+        tmp->setPlainText(placeholder->takeSnapshot());
+        tmp->setTextFormat(placeholder->textFormat());
+        tmp->contentHash()->setSaved(placeholder->contentDigest());
+    }
+    else if (placeholder && placeholder->hasContents())
+    {
+        tmp->setPlainText(placeholder->takeContents());
+        tmp->setTextFormat(placeholder->textFormat());
+        tmp->contentHash()->markSaved();
+    }
+    else
+    {
+        FileLoader loader(path);
+        loading = true;
+        bool loaded = loader.load(tmp->document(), this);
+        loading = false;
+        if (!loaded)
+        {
+            delete tmp;
+            if (!loader.wasCanceled()) QMessageBox::warning(this, tr("Error"), tr("Can't open the file!"), QMessageBox::Ok);
+            return nullptr;
+        }
+        tmp->setTextFormat(loader.format());
+        tmp->contentHash()->markSaved();
+    }
+    if (!hibernated && !path.isEmpty()) savedStamps.insert(path, QFileInfo(path).lastModified());
 
-        if (!extension.isEmpty())
+    QString extension = QFileInfo(name).suffix();
+    if (!extension.isEmpty())
+    {
+        highlighter = new SyntaxHighlighter(extension, tmp->document());
+        if (!highlighter->isSupported()) delete highlighter;
+        else
         {
-            highlighter = new SyntaxHighlighter(extension, tmp->document());
-            if (!highlighter->isSupported()) delete highlighter;
+            highlighter->setLazy(settings.value("LazyHighlighting", true).toBool(),
+                settings.value("HighlightMargin", 100).toInt());
+            connect(tmp, SIGNAL(visibleBlocksChanged(int, int)), highlighter, SLOT(setVisibleBlocks(int, int)));
+            connect(highlighter, &SyntaxHighlighter::rulesDisabled, this, &QtNotepad::rulesDisabled);
         }
-        file.close();
-        tmp->appendPlainText(buffer);
+    }
+    tmp->undoHistory()->setBudget(undoBudget);
+    tmp->journal()->setSource(path, name);
+    quint64 placeholderId = hibernated ? documents->idOf(placeholder) : 0;
+    if (hibernated && (!placeholderId || documents->isDirty(placeholderId))) tmp->journal()->checkpoint();
+    connect(tmp, SIGNAL(textChanged()), SLOT(changeParameter()));
+    connect(tmp, SIGNAL(cursorPositionChanged()), cursorTimer, SLOT(start()));
+    connect(tmp, SIGNAL(selectionChanged()), cursorTimer, SLOT(start()));
+    connect(tmp, SIGNAL(textChanged()), cursorTimer, SLOT(start()));
+    return tmp;
+}
 
-        int index = tabWgt->addTab(tmp, name);
+void QtNotepad::replacePage(int index, QWidget* page)
+{
+    QWidget* current = tabWgt->currentWidget();
+    quint64 id = documents->idOf(tabWgt->widget(index));
+
+    restoring = true;
+    tabWgt->removeTab(index);
+    tabWgt->insertTab(index, page, documents->title(id));
+    tabWgt->setTabToolTip(index, documents->path(id));
+    documents->setPage(id, page);
+    if (current && current != tabWgt->widget(index)) tabWgt->setCurrentWidget(current);
+    restoring = false;
+}
+
+void QtNotepad::materializeTab(int index)
+{
+    TRACE_SCOPE("QtNotepad::materializeTab");
+    TabPlaceholder* placeholder = qobject_cast<TabPlaceholder*>(tabWgt->widget(index));
+    if (!placeholder || restoring || loading) return;
+
+    restoring = true;
+    QWidget* page = createPage(placeholder->path(), placeholder);
+    restoring = false;
+    if (page)
+    {
+        replacePage(index, page);
         tabWgt->setCurrentIndex(index);
-        tabWgt->setTabWhatsThis(index, "Without changes");
-        tabWgt->setTabToolTip(index, path);
-        tabWgt->repaint();
-        QListWidgetItem* item = new QListWidgetItem;
-        item->setText(tabWgt->tabText(index));
-        item->setToolTip(tabWgt->tabToolTip(index));
-        currFiles->addItem(item);
-        changeCurrIndex(index);
-        connect(tmp, SIGNAL(textChanged()), SLOT(changeParameter()));
-        connect(tmp, &Editor::cursorPositionChanged, this, &QtNotepad::statusBarChange);
+        memory->forget(placeholder);
+        memory->touch(page);
+
+        int position = placeholder->cursorPosition();
+        int scroll = placeholder->scrollPosition();
+        if (Editor* editor = qobject_cast<Editor*>(page))
+        {
+            editor->journal()->setSource(placeholder->path(), documents->name(documents->idOf(page)));
+            if (position >= 0)
+            {
+                QTextCursor cursor = editor->textCursor();
+                cursor.setPosition(qMin(position, editor->document()->characterCount() - 1));
+                editor->setTextCursor(cursor);
+            }
+            if (scroll >= 0) QTimer::singleShot(0, editor, [editor, scroll]()
+            {
+                editor->verticalScrollBar()->setValue(scroll);
+            });
+        }
+        else if (LargeFileViewer* viewer = qobject_cast<LargeFileViewer*>(page))
+        {
+            if (position >= 0) viewer->goToLine(position);
+        }
+        delete placeholder;
     }
-    else
+    statusBarChange();
+}
+
+void QtNotepad::hibernateTab(int index)
+{
+    QWidget* page = tabWgt->widget(index);
+    if (!page || page == tabWgt->currentWidget() || qobject_cast<TabPlaceholder*>(page)) return;
+    quint64 id = documents->idOf(page);
+    if (qobject_cast<LargeFileViewer*>(page) && documents->isDirty(id)) return;
+
+    QString path = documents->path(id);
+    TabPlaceholder* placeholder = new TabPlaceholder(path, this);
+    if (Editor* editor = qobject_cast<Editor*>(page))
     {
-        QMessageBox::warning(this, tr("Error"), tr("Can't open the file!"), QMessageBox::Ok);
-        return;
+        if (path.isEmpty() || documents->isDirty(id))
+        {
+            placeholder->setSnapshot(editor->fileText());
+            editor->journal()->setParent(placeholder);
+        }
+        placeholder->setTextFormat(editor->textFormat());
+        placeholder->setContentDigest(editor->contentHash()->saved());
+        placeholder->setViewState(editor->textCursor().position(), editor->verticalScrollBar()->value());
     }
+    else if (LargeFileViewer* viewer = qobject_cast<LargeFileViewer*>(page))
+        placeholder->setViewState(int(qMin<qint64>(viewer->currentLine(), INT_MAX)), -1);
+
+    replacePage(index, placeholder);
+    memory->forget(page);
+    delete page;
+}
+
+void QtNotepad::hibernateTabs()
+{
+    TRACE_SCOPE("QtNotepad::hibernateTabs");
+    if (loading) return;
+    QList<QWidget*> pages;
+    for (int i = 0; i < tabWgt->count(); ++i) pages << tabWgt->widget(i);
+
+    const QList<QWidget*> cold = memory->coldPages(pages, tabWgt->currentWidget());
+    for (QWidget* page : cold) hibernateTab(tabWgt->indexOf(page));
+    statusBarChange();
 }
 
 void QtNotepad::saveFile()
 {
-    if (tabWgt->tabToolTip(tabWgt->currentIndex()) == "")
+    saveFile(tabWgt->currentIndex());
+}
+
+void QtNotepad::saveFile(int index)
+{
+    TRACE_SCOPE("QtNotepad::saveFile");
+    if (index < 0) return;
+    quint64 id = documents->idOf(tabWgt->widget(index));
+    QString path = documents->path(id);
+    if (path.isEmpty())
     {
+        tabWgt->setCurrentIndex(index);
         saveFileAs();
         return;
     }
-    QString path = tabWgt->tabToolTip(tabWgt->currentIndex());
-    QFile file(path);
-    if (file.open(QIODevice::WriteOnly))
+    if (!documents->isDirty(id) && savedStamps.contains(path) && savedStamps.value(path) == QFileInfo(path).lastModified()) return;
+    savingPaths.insert(path);
+    if (TabPlaceholder* placeholder = qobject_cast<TabPlaceholder*>(tabWgt->widget(index)))
     {
-        Editor* curr = qobject_cast<Editor*>(tabWgt->currentWidget());
-        if (curr)
-        {
-            file.write(curr->document()->toPlainText().toUtf8());
-            file.close();
-            tabWgt->setTabWhatsThis(tabWgt->currentIndex(), "Without changes");
-            tabWgt->setTabText(tabWgt->currentIndex(), path.section("/", -1, -1));
-        }
+        if (placeholder->hasSnapshot())
+            saver->save(id, path, placeholder->snapshotText(), -1, placeholder->textFormat());
+        return;
     }
-    else
+    if (LargeFileViewer* viewer = qobject_cast<LargeFileViewer*>(tabWgt->widget(index)))
     {
-        QMessageBox::warning(this, tr("Error"), tr("Can't save the file!"), QMessageBox::Ok);
+        if (saver->isSaving(path)) return;
+        viewer->setSaving(true);
+        saver->save(id, path, viewer->snapshot(), viewer->revision());
         return;
     }
+    Editor* curr = qobject_cast<Editor*>(tabWgt->widget(index));
+    if (!curr) return;
+    saver->save(id, path, curr->fileText(), curr->revision(), curr->textFormat());
 }
 
 void QtNotepad::saveFileAs()
 {
-    QString name = tabWgt->tabText(tabWgt->currentIndex()).remove('*');
+    int index = tabWgt->currentIndex();
+    if (!qobject_cast<Editor*>(tabWgt->widget(index))) return;
+    quint64 id = documents->idOf(tabWgt->widget(index));
+    QString name = documents->name(id);
     QString path = QFileDialog::getSaveFileName(this, "Save " + name, name);
     if (path.isEmpty()) return;
     if (QFileInfo(path).suffix().isEmpty()) path.append(".txt");
-    else
+
+    if (!documents->setPath(id, path, QFileInfo(path).fileName()))
     {
-        QFile file(path);
-        if (file.open(QIODevice::WriteOnly))
-        {
-            Editor* curr = qobject_cast<Editor*>(tabWgt->currentWidget());
-            if (curr)
-            {
-                file.write(curr->document()->toPlainText().toUtf8());
-                file.close();
-            }
-        }
-        else
-        {
-            QMessageBox::warning(this, tr("Error"), tr("Can't save the file!"), QMessageBox::Ok);
-            return;
-        }
+        QMessageBox::warning(this, tr("Error"), tr("The file is already open!"), QMessageBox::Ok);
+        return;
     }
-    filepaths.replace(tabWgt->currentIndex(), QDir(QFileInfo(path).path()));
-    filenames.replace(tabWgt->currentIndex(), QFileInfo(path).fileName());
-    name = path.section("/", -1, -1);
-
-    tabWgt->tabBar()->setTabText(tabWgt->currentIndex(), name);
-    tabWgt->tabBar()->setTabToolTip(tabWgt->currentIndex(), path);
-    tabWgt->setTabWhatsThis(tabWgt->currentIndex(), "Without changes");
-    saveFile();
+    qobject_cast<Editor*>(tabWgt->widget(index))->journal()->setSource(path, QFileInfo(path).fileName());
+    updateWatches();
+    saveFile(index);
 }
 
 void QtNotepad::saveAllFiles()
 {
+    TRACE_SCOPE("QtNotepad::saveAllFiles");
     int index = tabWgt->currentIndex();
-    for (int i = 0; i < tabWgt->count(); ++i)
+    const QList<quint64> dirty = documents->dirtyDocuments();
+    for (quint64 id : dirty) saveFile(tabWgt->indexOf(documents->page(id)));
+    tabWgt->setCurrentIndex(index);
+}
+
+void QtNotepad::fileSaved(quint64 id, const QString& path, int revision)
+{
+    TRACE_SCOPE("QtNotepad::fileSaved");
+    if (!saver->isSaving(path)) savingPaths.remove(path);
+    savedStamps.insert(path, QFileInfo(path).lastModified());
+    updateWatches();
+    QWidget* page = documents->page(id);
+    int index = page ? tabWgt->indexOf(page) : -1;
+    if (index < 0) return;
+
+    Editor* editor = qobject_cast<Editor*>(page);
+    LargeFileViewer* viewer = qobject_cast<LargeFileViewer*>(page);
+    bool current = qobject_cast<TabPlaceholder*>(page) != nullptr && revision == -1;
+    if (editor) current = editor->revision() == revision;
+    if (viewer)
     {
-        tabWgt->setCurrentIndex(i);
-        if (tabWgt->tabWhatsThis(tabWgt->currentIndex()) != "Without changes") saveFile();
+        current = viewer->revision() == revision;
+        viewer->setSaving(false);
+        viewer->reload();
     }
-    tabWgt->setCurrentIndex(index);
+    if (current && documents->path(id) == path) markClean(index);
+}
+
+void QtNotepad::fileSaveFailed(quint64 id, const QString& path, const QString& error)
+{
+    if (!saver->isSaving(path)) savingPaths.remove(path);
+    if (LargeFileViewer* viewer = qobject_cast<LargeFileViewer*>(documents->page(id)))
+    {
+        viewer->setSaving(false);
+        viewer->restore();
+    }
+    QMessageBox::warning(this, tr("Error"), tr("Can't save the file!") + "\n" + path + "\n" + error, QMessageBox::Ok);
+}
+
+void QtNotepad::fileUnencodable(quint64 id, const QString& path)
+{
+    if (!saver->isSaving(path)) savingPaths.remove(path);
+    QWidget* page = documents->page(id);
+    Editor* editor = qobject_cast<Editor*>(page);
+    TabPlaceholder* placeholder = qobject_cast<TabPlaceholder*>(page);
+    if (!editor && !placeholder) return;
+
+    TextFormat format = editor ? editor->textFormat() : placeholder->textFormat();
+    QMessageBox::StandardButton answer = QMessageBox::question(this, tr("Save"),
+        tr("Some characters can't be represented in %1, so the file was not saved.\n%2\nSave it as UTF-8 instead?")
+        .arg(QString::fromLatin1(format.encoding)).arg(path));
+    if (answer != QMessageBox::Yes) return;
+
+    page = documents->page(id);
+    editor = qobject_cast<Editor*>(page);
+    placeholder = qobject_cast<TabPlaceholder*>(page);
+    format.encoding = "UTF-8";
+    format.bom = false;
+    if (editor) editor->setTextFormat(format);
+    else if (placeholder) placeholder->setTextFormat(format);
+    else return;
+    saveFile(tabWgt->indexOf(page));
+}
+
+void QtNotepad::releaseFile(quint64 id)
+{
+    if (LargeFileViewer* viewer = qobject_cast<LargeFileViewer*>(documents->page(id))) viewer->release();
 }
 
 void QtNotepad::closeFile()
@@ -333,42 +693,42 @@ void QtNotepad::closeFile()
 
 void QtNotepad::closeFile(int index)
 {
-    if (tabWgt->tabWhatsThis(tabWgt->currentIndex()) != "Without changes")
+    TRACE_SCOPE("QtNotepad::closeFile");
+    if (index < 0) return;
+    quint64 id = documents->idOf(tabWgt->widget(index));
+    if (documents->isDirty(id))
     {
         QMessageBox::StandardButton reply;
         reply = QMessageBox::question(this, tr("Warning"), tr("Save before closing?"),
             QMessageBox::Yes | QMessageBox::No);
-        if (reply == QMessageBox::Yes) saveFile();
+        if (reply == QMessageBox::Yes) saveFile(index);
     }
-    filepaths.remove(index);
-    filenames.removeAt(index);
+    documents->remove(id);
+    memory->forget(tabWgt->widget(index));
     delete tabWgt->widget(index);
     deleteTab(index);
+    updateWatches();
 }
 
 void QtNotepad::closeAllFiles()
 {
-    bool flag = false;
-    for (int i = 0; i < tabWgt->count(); ++i)
-    {
-        if (tabWgt->tabWhatsThis(i) != "Without changes")
-        {
-            flag = true;
-            break;
-        }
-    }
-    if (flag)
+    TRACE_SCOPE("QtNotepad::closeAllFiles");
+    if (documents->hasDirty())
     {
         QMessageBox::StandardButton reply;
         reply = QMessageBox::question(this, tr("Warning"), tr("Save the changes?"),
             QMessageBox::Yes | QMessageBox::No);
         if (reply == QMessageBox::Yes) saveAllFiles();
     }
-    filepaths.clear();
-    filenames.clear();
+    documents->clear();
     fileIndex = 1;
-    while (tabWgt->count() > 0) delete tabWgt->widget(0);
+    while (tabWgt->count() > 0)
+    {
+        memory->forget(tabWgt->widget(0));
+        delete tabWgt->widget(0);
+    }
     currFiles->clear();
+    updateWatches();
 }
 
 void QtNotepad::closeWindow()
@@ -382,19 +742,20 @@ void QtNotepad::closeWindow()
 
     for (int i = 0; i < tabWgt->count(); i++)
     {
-        if (tabWgt->tabText(i).contains('*'))
-        {
-            filenames.push_back(names[i]);
-            filepaths.push_back(paths[i]);
-        }
+        quint64 id = documents->idOf(tabWgt->widget(i));
+        if (!documents->isDirty(id)) continue;
+        names.push_back(documents->name(id));
+        paths.push_back(documents->path(id).isEmpty() ? QDir::current() : QDir(QFileInfo(documents->path(id)).path()));
     }
 
+    saver->waitForDone();
     if (paths.isEmpty()) QApplication::quit();
     else
     {
         menu->fill(paths, names);
         int event = menu->exec();
         if (event == QDialog::Accepted) saveAllFiles();
+        saver->waitForDone();
         if (event != -1) QApplication::quit();
     }
 }
@@ -418,7 +779,9 @@ void QtNotepad::changeCurrIndex(QListWidgetItem* item)
 
 void QtNotepad::changeCurrIndex(int index)
 {
+    TRACE_SCOPE("QtNotepad::changeCurrIndex");
     currFiles->setCurrentRow(index);
+    memory->touch(tabWgt->widget(index));
     statusBarChange();
 }
 
@@ -430,28 +793,42 @@ void QtNotepad::changeIndexOnDelete()
 
 void::QtNotepad::changeParameter()
 {
-    if (!(tabWgt->tabText(tabWgt->currentIndex())).contains("*"))
+    TRACE_SCOPE("QtNotepad::changeParameter");
+    QWidget* page = qobject_cast<QWidget*>(sender());
+    if (!documents->idOf(page)) page = tabWgt->currentWidget();
+    Editor* editor = qobject_cast<Editor*>(page);
+    quint64 id = documents->idOf(page);
+    bool modified = editor ? editor->contentHash()->isModified() : true;
+    if (!modified && documents->isDirty(id)) editor->journal()->reset();
+    documents->setDirty(id, modified);
+}
+
+void QtNotepad::undo()
+{
+    if (Editor* editor = qobject_cast<Editor*>(tabWgt->currentWidget()))
     {
-        tabWgt->setTabWhatsThis(tabWgt->currentIndex(), "Changes");
-        tabWgt->setTabText(tabWgt->currentIndex(), tabWgt->tabText(tabWgt->currentIndex()) + "*");
+        editor->undoStep();
     }
 }
 
-void QtNotepad::changeContainers(int from, int to)
+void QtNotepad::redo()
 {
-    QString name = filenames.at(from);
-    filenames.replace(from, filenames.at(to));
-    filenames.replace(to, name);
-
-    QDir path = filepaths.at(from);
-    filepaths.replace(from, filepaths.at(to));
-    filepaths.replace(to, path);
+    if (Editor* editor = qobject_cast<Editor*>(tabWgt->currentWidget()))
+    {
+        editor->redo();
+    }
 }
 
 void QtNotepad::copy()
 {
-    Editor* editor = qobject_cast<Editor*>(tabWgt->currentWidget());
-    editor->copy();
+    if (Editor* editor = qobject_cast<Editor*>(tabWgt->currentWidget()))
+    {
+        editor->copy();
+    }
+    else if (LargeFileViewer* viewer = qobject_cast<LargeFileViewer*>(tabWgt->currentWidget()))
+    {
+        viewer->copy();
+    }
 }
 
 void QtNotepad::cut()
@@ -507,11 +884,12 @@ SaveDialog* QtNotepad::createDialog()
     SaveDialog* dialog = new SaveDialog(this);
     connect(dialog->btnSave, SIGNAL(clicked()), this, SLOT(saveAllFiles()));
     int row = 0;
-    for (int i = 0; i < currFiles->count(); ++i) {
-        tabWgt->setCurrentIndex(i);
-        if (tabWgt->tabWhatsThis(i) != "Without changes") {
-            QTableWidgetItem* file = new QTableWidgetItem(tabWgt->tabText(i));
-            QTableWidgetItem* path = new QTableWidgetItem(filepaths.at(i).canonicalPath());
+    for (int i = 0; i < tabWgt->count(); ++i) {
+        quint64 id = documents->idOf(tabWgt->widget(i));
+        if (documents->isDirty(id)) {
+            QTableWidgetItem* file = new QTableWidgetItem(documents->title(id));
+            QTableWidgetItem* path = new QTableWidgetItem(documents->path(id).isEmpty()
+                ? QDir::current().canonicalPath() : QFileInfo(documents->path(id)).canonicalPath());
             dialog->table->insertRow(row);
             dialog->table->setItem(row, 0, file);
             dialog->table->setItem(row, 1, path);
@@ -556,19 +934,473 @@ SaveDialog::SaveDialog(QWidget* parent) : QDialog(parent)
     connect(btnCancel, SIGNAL(clicked()), this, SLOT(reject()));
 }
 
-void QtNotepad::statusBarChange() {
+void QtNotepad::showFind()
+{
+    if (!findDialog)
+    {
+        findDialog = new FindDialog(this);
+        connect(findDialog, SIGNAL(findRequested()), SLOT(findAll()));
+        connect(findDialog, SIGNAL(nextRequested()), SLOT(findNext()));
+        connect(findDialog, SIGNAL(previousRequested()), SLOT(findPrevious()));
+        connect(findDialog, SIGNAL(replaceRequested()), SLOT(replaceAll()));
+    }
+    findDialog->showFind(false);
+}
+
+void QtNotepad::showRuleProfile()
+{
+    if (!ruleProfile)
+    {
+        ruleProfile = new RuleProfileDialog(this);
+        connect(ruleProfile, SIGNAL(statsReset()), SLOT(rehighlightAll()));
+    }
+    ruleProfile->refresh();
+    ruleProfile->show();
+    ruleProfile->raise();
+    ruleProfile->activateWindow();
+}
+
+void QtNotepad::rulesDisabled(const QStringList& patterns)
+{
+    statusBar()->showMessage(tr("Highlighting rules disabled for exceeding the time budget: %1").arg(patterns.join("  ")), 15000);
+    if (ruleProfile && ruleProfile->isVisible()) ruleProfile->refresh();
+}
+
+void QtNotepad::rehighlightAll()
+{
+    for (int i = 0; i < tabWgt->count(); ++i)
+    {
+        if (Editor* editor = qobject_cast<Editor*>(tabWgt->widget(i)))
+        {
+            const auto highlighters = editor->document()->findChildren<SyntaxHighlighter*>();
+            for (SyntaxHighlighter* item : highlighters) item->rehighlight();
+        }
+    }
+}
+
+void QtNotepad::showReplace()
+{
+    showFind();
+    findDialog->showFind(true);
+}
+
+QList<Editor*> QtNotepad::searchTargets()
+{
+    QList<Editor*> editors;
+    if (findDialog && findDialog->allTabs())
+    {
+        for (int i = 0; i < tabWgt->count(); ++i)
+            if (Editor* editor = qobject_cast<Editor*>(tabWgt->widget(i))) editors << editor;
+    }
+    else if (Editor* editor = qobject_cast<Editor*>(tabWgt->currentWidget())) editors << editor;
+    return editors;
+}
+
+void QtNotepad::findAll()
+{
+    TRACE_SCOPE("QtNotepad::findAll");
+    search->cancel();
+    for (int i = 0; i < tabWgt->count(); ++i)
+        if (Editor* editor = qobject_cast<Editor*>(tabWgt->widget(i))) editor->clearSearchMatches();
+
+    searchTotal = 0;
+    searchTabs = 0;
+    searchPending = 0;
+    SearchQuery query = findDialog->query();
+    QString error = SearchEngine::check(query);
+    if (!error.isEmpty())
+    {
+        findDialog->setStatus(error);
+        return;
+    }
+    const QList<Editor*> editors = searchTargets();
+    for (Editor* editor : editors)
+    {
+        ++searchPending;
+        search->find(editor, editor->document()->toPlainText(), query);
+    }
+    findDialog->setStatus(searchPending ? tr("Searching...") : tr("No open documents"));
+}
+
+void QtNotepad::findNext()
+{
+    Editor* editor = qobject_cast<Editor*>(tabWgt->currentWidget());
+    if (!editor) return;
+    if (editor->searchMatchCount() > 0) editor->findNext();
+    else if (findDialog && findDialog->isVisible()) findAll();
+    else showFind();
+}
+
+void QtNotepad::findPrevious()
+{
+    if (Editor* editor = qobject_cast<Editor*>(tabWgt->currentWidget())) editor->findNext(true);
+}
+
+void QtNotepad::replaceAll()
+{
+    TRACE_SCOPE("QtNotepad::replaceAll");
+    search->cancel();
+    searchPending = 0;
+    searchTotal = 0;
+    searchTabs = 0;
+    SearchQuery query = findDialog->query();
+    QString error = SearchEngine::check(query);
+    if (!error.isEmpty())
+    {
+        findDialog->setStatus(error);
+        return;
+    }
+    const QList<Editor*> editors = searchTargets();
+    for (Editor* editor : editors)
+    {
+        ++searchPending;
+        search->replaceAll(editor, editor->document()->toPlainText(), query, findDialog->replacement(), editor->revision());
+    }
+    findDialog->setStatus(searchPending ? tr("Replacing...") : tr("No open documents"));
+}
+
+void QtNotepad::searchFound(QObject* page, const QVector<SearchMatch>& matches)
+{
+    Editor* editor = qobject_cast<Editor*>(page);
+    if (editor && tabWgt->indexOf(editor) >= 0) editor->appendSearchMatches(matches);
+}
+
+void QtNotepad::searchFinished(QObject*, int count)
+{
+    searchTotal += count;
+    if (count > 0) ++searchTabs;
+    if (--searchPending > 0) return;
+
+    Editor* current = qobject_cast<Editor*>(tabWgt->currentWidget());
+    if (current && current->searchMatchCount() > 0) current->findNext();
+    findDialog->setStatus(tr("%1 matches in %2 tabs").arg(searchTotal).arg(searchTabs));
+}
+
+void QtNotepad::searchReplaced(QObject* page, const QVector<SearchReplacement>& edits, int revision)
+{
+    Editor* editor = qobject_cast<Editor*>(page);
+    int count = edits.size();
+    if (!editor || tabWgt->indexOf(editor) < 0 || editor->revision() != revision) count = 0;
+    else if (count > 0)
+    {
+        QTextCursor cursor(editor->document());
+        cursor.beginEditBlock();
+        for (auto edit = edits.crbegin(); edit != edits.crend(); ++edit)
+        {
+            cursor.setPosition(edit->position);
+            cursor.setPosition(edit->position + edit->length, QTextCursor::KeepAnchor);
+            cursor.insertText(edit->text);
+        }
+        cursor.endEditBlock();
+    }
+    searchTotal += count;
+    if (count > 0) ++searchTabs;
+    if (--searchPending > 0) return;
+    findDialog->setStatus(tr("Replaced %1 matches in %2 tabs").arg(searchTotal).arg(searchTabs));
+}
+
+QString QtNotepad::searchRoot()
+{
+    if (!filesModel) return QString();
+    QModelIndex index = tree->currentIndex();
+    QString path = filesModel->filePath(index);
+    if (path.isEmpty()) return filesModel->rootPath();
+    return filesModel->isDir(index) ? path : QFileInfo(path).absolutePath();
+}
+
+int QtNotepad::tabIndex(const QString& path)
+{
+    quint64 id = documents->find(path);
+    return id ? tabWgt->indexOf(documents->page(id)) : -1;
+}
+
+void QtNotepad::goToLine(QWidget* page, qint64 line)
+{
+    if (Editor* editor = qobject_cast<Editor*>(page))
+    {
+        QTextBlock block = editor->document()->findBlockByNumber(int(line - 1));
+        if (!block.isValid()) return;
+        editor->setTextCursor(QTextCursor(block));
+        editor->centerCursor();
+        editor->setFocus();
+    }
+    else if (LargeFileViewer* viewer = qobject_cast<LargeFileViewer*>(page)) viewer->goToLine(line - 1);
+}
+
+void QtNotepad::showFindInFiles()
+{
+    findInFilesDock->show();
+    findInFilesDock->raise();
+    QString root = searchRoot();
+    filesStatus->setText(root.isEmpty() ? tr("Select a folder in the Explorer") : root);
+    filesPattern->setFocus();
+    filesPattern->selectAll();
+}
+
+void QtNotepad::findInFiles()
+{
+    TRACE_SCOPE("QtNotepad::findInFiles");
+    QString root = searchRoot();
+    if (root.isEmpty())
+    {
+        fileExplorer->show();
+        filesStatus->setText(tr("Select a folder in the Explorer"));
+        return;
+    }
+
+    SearchQuery query;
+    query.pattern = filesPattern->text();
+    query.regex = filesRegex->isChecked();
+    query.sensitivity = filesCase->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    QString error = SearchEngine::check(query);
+    if (!error.isEmpty())
+    {
+        filesStatus->setText(error);
+        return;
+    }
+
+    QSettings settings("Company", "QtNotepad");
+    qint64 sizeLimit = settings.value("FindInFilesSizeLimit", 32).toLongLong() * 1024 * 1024;
+    int maxHits = settings.value("FindInFilesMaxHits", 20000).toInt();
+
+    filesResults->clear();
+    filesStatus->setText(tr("Searching %1...").arg(root));
+    fileSearch->start(root, query, sizeLimit, maxHits);
+}
+
+void QtNotepad::filesFound(const QVector<FileHit>& hits)
+{
+    filesResults->setUpdatesEnabled(false);
+    for (const FileHit& hit : hits)
+    {
+        QListWidgetItem* item = new QListWidgetItem(QString("%1:%2: %3")
+            .arg(QDir::toNativeSeparators(hit.path)).arg(hit.line).arg(hit.text));
+        item->setData(Qt::UserRole, hit.path);
+        item->setData(Qt::UserRole + 1, hit.line);
+        filesResults->addItem(item);
+    }
+    filesResults->setUpdatesEnabled(true);
+}
+
+void QtNotepad::filesFinished(int files, int hits)
+{
+    filesStatus->setText(tr("%1 lines in %2 searched files").arg(filesResults->count()).arg(files)
+        + (hits > filesResults->count() ? tr(" (limit reached)") : QString()));
+}
+
+void QtNotepad::openHit(QListWidgetItem* item)
+{
+    QString path = item->data(Qt::UserRole).toString();
+    qint64 line = item->data(Qt::UserRole + 1).toLongLong();
+    int index = tabIndex(path);
+    if (index < 0)
+    {
+        openFile(path);
+        index = tabIndex(path);
+        if (index < 0) return;
+    }
+    tabWgt->setCurrentIndex(index);
+    goToLine(tabWgt->widget(index), line);
+}
+
+void QtNotepad::updateWatches()
+{
+    QSet<QString> wanted;
+    const QStringList paths = documents->paths();
+    for (const QString& path : paths)
+        if (QFileInfo::exists(path)) wanted.insert(path);
+
+    const QStringList watched = watcher->files();
+    for (const QString& path : watched)
+    {
+        if (!wanted.contains(path)) watcher->removePath(path);
+        else wanted.remove(path);
+    }
+    if (!wanted.isEmpty()) watcher->addPaths(wanted.values());
+}
+
+void QtNotepad::markClean(int index)
+{
+    if (Editor* editor = qobject_cast<Editor*>(tabWgt->widget(index)))
+    {
+        editor->journal()->reset();
+        editor->contentHash()->markSaved();
+    }
+    else if (TabPlaceholder* placeholder = qobject_cast<TabPlaceholder*>(tabWgt->widget(index)))
+    {
+        if (EditJournal* journal = placeholder->findChild<EditJournal*>()) journal->reset();
+        if (placeholder->hasSnapshot()) placeholder->setContentDigest(ContentHash::digest(placeholder->snapshotText()));
+    }
+    documents->setDirty(documents->idOf(tabWgt->widget(index)), false);
+}
+
+void QtNotepad::fileChangedOnDisk(const QString& path)
+{
+    changedPaths.insert(path);
+    reloadTimer->start();
+}
+
+void QtNotepad::reloadChangedFiles()
+{
+    TRACE_SCOPE("QtNotepad::reloadChangedFiles");
+    if (loading)
+    {
+        reloadTimer->start();
+        return;
+    }
+    const QSet<QString> paths = changedPaths;
+    changedPaths.clear();
+    updateWatches();
+
+    for (const QString& path : paths)
+    {
+        QFileInfo info(path);
+        if (savingPaths.contains(path))
+        {
+            changedPaths.insert(path);
+            reloadTimer->start();
+            continue;
+        }
+        if (!info.exists() || savedStamps.value(path) == info.lastModified()) continue;
+
+        int index = tabIndex(path);
+        if (index < 0) continue;
+        QWidget* page = tabWgt->widget(index);
+        if (TabPlaceholder* placeholder = qobject_cast<TabPlaceholder*>(page))
+        {
+            if (placeholder->hasContents()) placeholder->takeContents();
+            continue;
+        }
+
+        if (documents->isDirty(documents->idOf(page))
+            && QMessageBox::question(this, tr("Warning"), tr("%1 has changed on disk. Reload it and lose your changes?").arg(path),
+                QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes)
+            continue;
+        savedStamps.insert(path, info.lastModified());
+
+        if (Editor* editor = qobject_cast<Editor*>(page)) reloadEditor(editor, path);
+        else if (LargeFileViewer* viewer = qobject_cast<LargeFileViewer*>(page))
+        {
+            viewer->reload();
+            markClean(index);
+        }
+    }
+}
+
+void QtNotepad::reloadEditor(Editor* editor, const QString& path)
+{
+    QPointer<Editor> target(editor);
+    QPointer<QtNotepad> window(this);
+    QString buffer = editor->fileText();
+    int revision = editor->revision();
+    QThreadPool::globalInstance()->start([window, target, path, buffer, revision]()
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) return;
+        TextFormat format;
+        QVector<DiffHunk> hunks = diffLines(buffer, FileCodec::decodeAll(file.readAll(), &format));
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [window, target, path, hunks, revision, format]()
+        {
+            if (!window || !target) return;
+            int index = window->tabWgt->indexOf(target);
+            if (index < 0) return;
+            if (target->revision() != revision)
+            {
+                window->fileChangedOnDisk(path);
+                return;
+            }
+
+            if (!hunks.isEmpty())
+            {
+                QTextCursor cursor(target->document());
+                cursor.beginEditBlock();
+                for (int i = hunks.size() - 1; i >= 0; --i)
+                {
+                    cursor.setPosition(hunks.at(i).position);
+                    cursor.setPosition(hunks.at(i).position + hunks.at(i).length, QTextCursor::KeepAnchor);
+                    cursor.insertText(hunks.at(i).text);
+                }
+                cursor.endEditBlock();
+            }
+            target->setTextFormat(format);
+            window->markClean(index);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void QtNotepad::cursorChange() {
+    TRACE_SCOPE("QtNotepad::cursorChange");
     Editor* curr = qobject_cast<Editor*>(tabWgt->currentWidget());
-    if (curr) label->setText(QString("String: %1 Column: %2 ")
-        .arg((curr->cursorRect().bottom() - 18) / 16 + 1)
-        .arg((curr->cursorRect().left() - 3) / 4 + 1));
+    if (!curr)
+    {
+        statsLabel->clear();
+        undoLabel->clear();
+        if (LargeFileViewer* viewer = qobject_cast<LargeFileViewer*>(tabWgt->currentWidget()))
+            label->setText(QString("String: %1 of %2 ").arg(viewer->currentLine() + 1).arg(viewer->lineCount()));
+        return;
+    }
+
+    QTextCursor cursor = curr->textCursor();
+    label->setText(QString("String: %1 Column: %2 %3 ")
+        .arg(cursor.blockNumber() + 1)
+        .arg(cursor.positionInBlock() + 1)
+        .arg(curr->textFormat().name()));
+    UndoHistory* history = curr->undoHistory();
+    undoLabel->setText(QString("Undo: %1 KB, %2 checkpoints (%3 KB, %4 KB on disk), all tabs %5 KB ")
+        .arg(history->liveBytes() / 1024)
+        .arg(history->checkpointCount())
+        .arg(history->storedBytes() / 1024)
+        .arg(history->spilledBytes() / 1024)
+        .arg(UndoHistory::globalStoredBytes() / 1024));
+
+    QTextDocument* doc = curr->document();
+    TextStats* stats = curr->textStats();
+    QString total = QString("%1 chars, %2 words, %3 lines ")
+        .arg(doc->characterCount() - 1)
+        .arg(stats->words())
+        .arg(doc->blockCount());
+    if (!cursor.hasSelection())
+    {
+        statsLabel->setText(total);
+        return;
+    }
+
+    int start = cursor.selectionStart();
+    int end = cursor.selectionEnd();
+    QTextBlock first = doc->findBlock(start);
+    QTextBlock last = doc->findBlock(end);
+    qint64 words = 0;
+    if (first == last) words = TextStats::countWords(QStringView(first.text()).mid(start - first.position(), end - start));
+    else
+    {
+        words = TextStats::countWords(QStringView(first.text()).mid(start - first.position()))
+            + TextStats::countWords(QStringView(last.text()).left(end - last.position()))
+            + stats->words(first.blockNumber() + 1, last.blockNumber());
+    }
+    statsLabel->setText(QString("Selected: %1 chars, %2 words, %3 lines of ")
+        .arg(end - start)
+        .arg(words)
+        .arg(last.blockNumber() - first.blockNumber() + 1) + total);
+}
+
+void QtNotepad::statusBarChange() {
+    TRACE_SCOPE("QtNotepad::statusBarChange");
+    cursorChange();
+
+    QList<QWidget*> pages;
+    for (int i = 0; i < tabWgt->count(); ++i) pages << tabWgt->widget(i);
+    memoryLabel->setText(QString("Memory: %1 / %2 MB ")
+        .arg(memory->usage(pages) / (1024 * 1024))
+        .arg(memory->budget() / (1024 * 1024)));
 }
 
 void QtNotepad::saveSettings() {
     QSettings settings("Company", "QtNotepad");
     QStringList openedTabs;
     for (int i = 0; i < tabWgt->count(); ++i) {
-        if (tabWgt->tabToolTip(i) != "")
-            openedTabs << tabWgt->tabToolTip(i);
+        QString path = documents->path(documents->idOf(tabWgt->widget(i)));
+        if (!path.isEmpty())
+            openedTabs << path;
     }
 
     settings.setValue("OpenedTabs", openedTabs);
@@ -577,9 +1409,93 @@ void QtNotepad::saveSettings() {
 void QtNotepad::loadSettings() {
     QSettings settings("Company", "QtNotepad");
     QStringList openedTabs = settings.value("OpenedTabs").toStringList();
+    qint64 budget = settings.value("SessionPrefetchBudget", 64).toLongLong() * 1024 * 1024;
+    qint64 threshold = settings.value("LargeFileThreshold", 128).toLongLong() * 1024 * 1024;
+    qint64 reserved = 0;
+
+    memory->setBudget(settings.value("MemoryBudget", 512).toLongLong() * 1024 * 1024);
+    memory->setColdAfter(settings.value("HibernateAfter", 120).toLongLong() * 1000);
+    memoryTimer->start(30000);
+    undoBudget = settings.value("UndoBudget", 32).toLongLong() * 1024 * 1024;
+    UndoHistory::setGlobalBudget(settings.value("UndoGlobalBudget", 256).toLongLong() * 1024 * 1024);
+    FileCodec::setLegacyEncoding(settings.value("LegacyEncoding", "ISO-8859-1").toByteArray());
+    LanguageRegistry::setRuleBudget(settings.value("RuleTimeBudget", 2.0).toDouble() * 1000000, settings.value("RuleStrikes", 3).toInt());
+
+    restoring = true;
     for (const QString& filePath : openedTabs) {
-        openFile(filePath);
+        QFileInfo info(filePath);
+        if (!info.isFile()) continue;
+
+        if (documents->find(filePath)) continue;
+        TabPlaceholder* placeholder = new TabPlaceholder(filePath, this);
+        addDocument(placeholder, filePath, info.fileName());
+
+        qint64 estimate = info.size() * 2;
+        if (info.size() > threshold || reserved + estimate > budget) continue;
+        reserved += estimate;
+
+        QPointer<TabPlaceholder> target(placeholder);
+        QThreadPool::globalInstance()->start([target, filePath]()
+        {
+            QFile file(filePath);
+            if (!file.open(QIODevice::ReadOnly)) return;
+            TextFormat format;
+            QString contents = FileCodec::decodeAll(file.readAll(), &format);
+            QMetaObject::invokeMethod(QCoreApplication::instance(), [target, contents, format]()
+            {
+                if (!target || target->hasContents()) return;
+                target->setContents(contents);
+                target->setTextFormat(format);
+            }, Qt::QueuedConnection);
+        });
+    }
+    restoring = false;
+    updateWatches();
+
+    if (tabWgt->count() > 0)
+    {
         tabWgt->setCurrentIndex(0);
+        materializeTab(0);
+    }
+    recoverDocuments();
+}
+
+void QtNotepad::recoverDocuments()
+{
+    int skipped = 0;
+    const QVector<RecoveredDocument> recovered = EditJournal::recover(&skipped);
+    if (recovered.isEmpty())
+    {
+        if (skipped) QMessageBox::warning(this, tr("Recovery"),
+            tr("%1 unsaved documents could not be recovered because their files changed on disk.").arg(skipped), QMessageBox::Ok);
+        return;
     }
 
+    QString question = tr("Recover %1 unsaved documents from the previous session?").arg(recovered.size());
+    if (skipped) question += "\n" + tr("%1 more could not be recovered because their files changed on disk.").arg(skipped);
+    if (QMessageBox::question(this, tr("Recovery"), question, QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes)
+    {
+        for (const RecoveredDocument& document : recovered) EditJournal::remove(document.journal);
+        return;
+    }
+
+    for (const RecoveredDocument& document : recovered)
+    {
+        if (!document.path.isEmpty() && tabIndex(document.path) >= 0) closeFile(tabIndex(document.path));
+
+        TabPlaceholder placeholder(document.path);
+        placeholder.setSnapshot(document.text);
+        placeholder.setTextFormat(document.format);
+        restoring = true;
+        QWidget* page = createPage(document.path, &placeholder);
+        restoring = false;
+        if (!page) continue;
+
+        QString name = document.title.isEmpty() ? document.path.section("/", -1, -1) : document.title;
+        if (Editor* editor = qobject_cast<Editor*>(page)) editor->journal()->setSource(document.path, name);
+        addDocument(page, document.path, name, true);
+        EditJournal::remove(document.journal);
+    }
+    updateWatches();
+    if (tabWgt->count() > 0) tabWgt->setCurrentIndex(tabWgt->count() - 1);
 }
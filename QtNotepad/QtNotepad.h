@@ -3,6 +3,19 @@
 #include "Editor.h"
 #include "SyntaxHighlighter.h"
 #include "Menu.h"
+#include "FileLoader.h"
+#include "LargeFileViewer.h"
+#include "FileSaver.h"
+#include "TabPlaceholder.h"
+#include "MemoryManager.h"
+#include "SearchEngine.h"
+#include "FindDialog.h"
+#include "FileSearch.h"
+#include "RuleProfileDialog.h"
+#include "TextDiff.h"
+#include "ExplorerModel.h"
+#include "QuickOpenDialog.h"
+#include "DocumentRegistry.h"
 #include <QMainWindow>
 #include <QGridLayout>
 #include <QTabWidget>
@@ -20,8 +33,9 @@
 #include <QDockWidget>
 #include <QListWidget>
 #include <QListWidgetItem>
+#include <QLineEdit>
+#include <QCheckBox>
 #include <QTreeView>
-#include <QFileSystemModel>
 #include <QModelIndex>
 #include <QCloseEvent>
 #include <QDragEnterEvent>
@@ -35,6 +49,14 @@
 #include <QPushButton>
 #include <QStatusBar>
 #include <QSettings>
+#include <QPointer>
+#include <QThreadPool>
+#include <QTimer>
+#include <QFileSystemWatcher>
+#include <QDateTime>
+#include <QSet>
+#include <QScrollBar>
+#include <climits>
 
 class SaveDialog;
 
@@ -42,23 +64,54 @@ class QtNotepad : public QMainWindow {
     Q_OBJECT
 
 public:
-    explicit QtNotepad(QWidget* parent = nullptr);
+    explicit QtNotepad(QWidget* parent = nullptr, bool session = true);
 
 private:
+    friend class Benchmark;
+
     QTabWidget* tabWgt;
     Menu* menu;
     SyntaxHighlighter* highlighter;
+    FileSaver* saver;
+    MemoryManager* memory;
+    DocumentRegistry* documents;
+    QTimer* memoryTimer;
+    SearchEngine* search;
+    FindDialog* findDialog;
+    RuleProfileDialog* ruleProfile;
+    FileIndex* workspaceIndex;
+    QuickOpenDialog* quickOpen;
+    int searchPending;
+    int searchTotal;
+    int searchTabs;
 
     QListWidget* currFiles;
-    QFileSystemModel* filesModel;
+    ExplorerModel* filesModel;
     QTreeView* tree;
     int fileIndex;
+    bool restoring;
+    bool loading;
     QDockWidget* openedFiles;
     QDockWidget* fileExplorer;
-    QStringList filenames;
-    QVector<QDir> filepaths;
+    QDockWidget* findInFilesDock;
+    QLineEdit* filesPattern;
+    QCheckBox* filesCase;
+    QCheckBox* filesRegex;
+    QLabel* filesStatus;
+    QListWidget* filesResults;
+    FileSearch* fileSearch;
 
     QLabel* label;
+    QLabel* statsLabel;
+    QLabel* memoryLabel;
+    QLabel* undoLabel;
+    qint64 undoBudget;
+    QFileSystemWatcher* watcher;
+    QTimer* reloadTimer;
+    QTimer* cursorTimer;
+    QSet<QString> changedPaths;
+    QSet<QString> savingPaths;
+    QHash<QString, QDateTime> savedStamps;
 
     QAction* create;
     QAction* open;
@@ -75,9 +128,26 @@ private:
     void makeToolBar();
     void makeOpenedFilesDock();
     void makeFileExplorerDock();
+    void makeFindInFilesDock();
+
+    int addDocument(QWidget*, const QString&, const QString&, bool dirty = false);
+    QWidget* createPage(const QString&, TabPlaceholder* placeholder = nullptr);
+    void replacePage(int, QWidget*);
+    void hibernateTab(int);
+    QList<Editor*> searchTargets();
+    QString searchRoot();
+    QString workspaceRoot();
+    QStringList ignorePatterns();
+    int tabIndex(const QString&);
+    void goToLine(QWidget*, qint64);
+    void updateWatches();
+    void markClean(int);
+    void reloadEditor(Editor*, const QString&);
+    void recoverDocuments();
 
     SaveDialog* createDialog();
     void statusBarChange();
+    void cursorChange();
 
     void saveSettings();
 
@@ -91,15 +161,23 @@ private slots:
     void openFile();
     void openFile(const QString&);
     void openFile(QModelIndex);
+    void openFolder();
+    void showExplorer(bool);
+    void showQuickOpen();
     void closeFile();
     void closeFile(int);
     void saveFile();
+    void saveFile(int);
     void saveFileAs();
     void saveAllFiles();
     void closeAllFiles();
     void closeWindow();
+    void fileSaved(quint64, const QString&, int);
+    void fileSaveFailed(quint64, const QString&, const QString&);
+    void fileUnencodable(quint64, const QString&);
+    void releaseFile(quint64);
 
-    void changeContainers(int, int);
+    void documentChanged(quint64);
     void changeParameter();
 
     void changeTabIndex(int, int);
@@ -107,12 +185,36 @@ private slots:
     void changeCurrIndex(int);
     void changeCurrIndex(QListWidgetItem*);
     void changeIndexOnDelete();
+    void materializeTab(int);
+    void hibernateTabs();
 
+    void undo();
+    void redo();
     void copy();
     void paste();
     void cut();
     void selectAll();
     void clear();
+
+    void showFind();
+    void showReplace();
+    void findAll();
+    void findNext();
+    void findPrevious();
+    void replaceAll();
+    void searchFound(QObject*, const QVector<SearchMatch>&);
+    void searchFinished(QObject*, int);
+    void searchReplaced(QObject*, const QVector<SearchReplacement>&, int);
+    void showFindInFiles();
+    void findInFiles();
+    void filesFound(const QVector<FileHit>&);
+    void filesFinished(int, int);
+    void openHit(QListWidgetItem*);
+    void fileChangedOnDisk(const QString&);
+    void showRuleProfile();
+    void rulesDisabled(const QStringList&);
+    void rehighlightAll();
+    void reloadChangedFiles();
 };
 
 class SaveDialog : public QDialog
@@ -0,0 +1,91 @@
+#include "QuickOpenDialog.h"
+#include <QApplication>
+#include <QDir>
+#include <QFileInfo>
+
+static const int maxResults = 50;
+
+QuickOpenDialog::QuickOpenDialog(FileIndex* fileIndex, QWidget* parent) : QDialog(parent), index(fileIndex)
+{
+    setWindowTitle(tr("Go to file"));
+    resize(600, 400);
+    edit = new QLineEdit;
+    edit->setPlaceholderText(tr("Type part of a file name"));
+    edit->installEventFilter(this);
+    list = new QListWidget;
+    list->setUniformItemSizes(true);
+    status = new QLabel;
+
+    QVBoxLayout* layout = new QVBoxLayout;
+    layout->addWidget(edit);
+    layout->addWidget(list);
+    layout->addWidget(status);
+    setLayout(layout);
+
+    connect(edit, SIGNAL(textChanged(QString)), SLOT(search()));
+    connect(edit, SIGNAL(returnPressed()), SLOT(choose()));
+    connect(list, SIGNAL(itemActivated(QListWidgetItem*)), SLOT(choose()));
+    connect(index, &FileIndex::results, this, &QuickOpenDialog::showResults);
+    connect(index, &FileIndex::ready, this, &QuickOpenDialog::indexReady);
+}
+
+void QuickOpenDialog::popup()
+{
+    indexReady(index->size());
+    show();
+    raise();
+    activateWindow();
+    edit->setFocus();
+    edit->selectAll();
+}
+
+bool QuickOpenDialog::eventFilter(QObject* object, QEvent* event)
+{
+    if (object == edit && event->type() == QEvent::KeyPress)
+    {
+        int key = static_cast<QKeyEvent*>(event)->key();
+        if (key == Qt::Key_Up || key == Qt::Key_Down || key == Qt::Key_PageUp || key == Qt::Key_PageDown)
+        {
+            QApplication::sendEvent(list, event);
+            return true;
+        }
+    }
+    return QDialog::eventFilter(object, event);
+}
+
+void QuickOpenDialog::search()
+{
+    index->query(edit->text(), maxResults);
+}
+
+void QuickOpenDialog::showResults(const QString& text, const QStringList& paths)
+{
+    if (text != edit->text()) return;
+    list->clear();
+    QDir root(index->root());
+    for (const QString& path : paths)
+    {
+        QFileInfo info(path);
+        QString folder = QDir::toNativeSeparators(root.relativeFilePath(info.path()));
+        QListWidgetItem* item = new QListWidgetItem(folder == "." ? info.fileName() : info.fileName() + "    " + folder);
+        item->setData(Qt::UserRole, path);
+        item->setToolTip(path);
+        list->addItem(item);
+    }
+    if (list->count()) list->setCurrentRow(0);
+}
+
+void QuickOpenDialog::indexReady(int files)
+{
+    status->setText(index->isBuilding() ? tr("Indexing %1...").arg(index->root())
+        : tr("%n files in %1", "", files).arg(index->root()));
+    if (isVisible() && !edit->text().isEmpty()) search();
+}
+
+void QuickOpenDialog::choose()
+{
+    QListWidgetItem* item = list->currentItem();
+    if (!item) return;
+    hide();
+    emit fileChosen(item->data(Qt::UserRole).toString());
+}
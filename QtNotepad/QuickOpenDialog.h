@@ -0,0 +1,35 @@
+#pragma once
+#include "FileIndex.h"
+#include <QDialog>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QLabel>
+#include <QVBoxLayout>
+#include <QKeyEvent>
+
+class QuickOpenDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit QuickOpenDialog(FileIndex*, QWidget* parent = nullptr);
+
+    void popup();
+
+signals:
+    void fileChosen(const QString&);
+
+protected:
+    bool eventFilter(QObject*, QEvent*) override;
+
+private slots:
+    void search();
+    void showResults(const QString&, const QStringList&);
+    void indexReady(int);
+    void choose();
+
+private:
+    FileIndex* index;
+    QLineEdit* edit;
+    QListWidget* list;
+    QLabel* status;
+};
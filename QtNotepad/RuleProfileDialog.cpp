@@ -0,0 +1,125 @@
+#include "RuleProfileDialog.h"
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QTextStream>
+#include <QFile>
+
+RuleProfileDialog::RuleProfileDialog(QWidget* parent) : QDialog(parent)
+{
+    setWindowTitle(tr("Highlighting profile"));
+    resize(800, 400);
+    table = new QTableWidget(0, 8);
+    table->setHorizontalHeaderLabels({ tr("Language"), tr("Rule"), tr("Attempts"), tr("Matches"),
+        tr("Total, ms"), tr("Worst, ms"), tr("Over budget"), tr("State") });
+    table->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->verticalHeader()->hide();
+    status = new QLabel;
+    btnRefresh = new QPushButton(tr("Refresh"));
+    btnReset = new QPushButton(tr("Reset"));
+    btnExport = new QPushButton(tr("Export"));
+
+    QHBoxLayout* buttons = new QHBoxLayout;
+    buttons->addWidget(status, 1);
+    buttons->addWidget(btnRefresh);
+    buttons->addWidget(btnReset);
+    buttons->addWidget(btnExport);
+    QVBoxLayout* layout = new QVBoxLayout;
+    layout->addWidget(table);
+    layout->addLayout(buttons);
+    setLayout(layout);
+
+    connect(btnRefresh, SIGNAL(clicked()), SLOT(refresh()));
+    connect(btnReset, SIGNAL(clicked()), SLOT(reset()));
+    connect(btnExport, SIGNAL(clicked()), SLOT(exportProfile()));
+}
+
+void RuleProfileDialog::addRow(const QString& language, const QString& rule, const RuleStats& stats, bool budgeted)
+{
+    int row = table->rowCount();
+    table->insertRow(row);
+    auto number = [](const QVariant& value)
+    {
+        QTableWidgetItem* item = new QTableWidgetItem;
+        item->setData(Qt::DisplayRole, value);
+        item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        return item;
+    };
+    int over = stats.overBudget.loadRelaxed();
+    bool disabled = stats.disabled.loadRelaxed();
+    table->setItem(row, 0, new QTableWidgetItem(language));
+    table->setItem(row, 1, new QTableWidgetItem(rule));
+    table->setItem(row, 2, number(stats.attempts.loadRelaxed()));
+    table->setItem(row, 3, number(stats.matches.loadRelaxed()));
+    table->setItem(row, 4, number(stats.totalNs.loadRelaxed() / 1e6));
+    table->setItem(row, 5, number(stats.worstNs.loadRelaxed() / 1e6));
+    table->setItem(row, 6, number(over));
+    table->setItem(row, 7, new QTableWidgetItem(disabled ? tr("Disabled") : over ? tr("Slow") : budgeted ? tr("OK") : "-"));
+
+    if (!over) return;
+    QColor color = disabled ? QColor(255, 200, 200) : QColor(255, 240, 200);
+    for (int column = 0; column < table->columnCount(); ++column) table->item(row, column)->setBackground(color);
+}
+
+void RuleProfileDialog::refresh()
+{
+    table->setSortingEnabled(false);
+    table->setRowCount(0);
+    int slow = 0;
+    int disabled = 0;
+    const auto languages = LanguageRegistry::instance().definitions();
+    for (const QSharedPointer<const LanguageDefinition>& language : languages)
+    {
+        if (language->keywordStats && language->keywordPass != -1)
+            addRow(language->name, tr("%1 keywords").arg(language->keywordNames.size()), *language->keywordStats, false);
+        for (const HighlightingRule& rule : language->rules)
+        {
+            addRow(language->name, rule.pattern.pattern(), *rule.stats, true);
+            if (rule.stats->overBudget.loadRelaxed()) ++slow;
+            if (rule.stats->disabled.loadRelaxed()) ++disabled;
+        }
+    }
+    table->setSortingEnabled(true);
+    table->sortByColumn(4, Qt::DescendingOrder);
+    LanguageRegistry& registry = LanguageRegistry::instance();
+    status->setText(tr("Budget %1 ms per %2 chars, %3 rules over budget, %4 disabled. Styles loaded in %5 ms, regex compile %6 ms")
+        .arg(LanguageRegistry::ruleBudget() / 1e6).arg(LanguageRegistry::budgetLength).arg(slow).arg(disabled)
+        .arg(registry.loadTime() / 1e6).arg(registry.compileTime() / 1e6));
+}
+
+void RuleProfileDialog::reset()
+{
+    const auto languages = LanguageRegistry::instance().definitions();
+    for (const QSharedPointer<const LanguageDefinition>& language : languages)
+    {
+        if (language->keywordStats) language->keywordStats->reset();
+        for (const HighlightingRule& rule : language->rules) rule.stats->reset();
+    }
+    refresh();
+    emit statsReset();
+}
+
+void RuleProfileDialog::exportProfile()
+{
+    QString path = QFileDialog::getSaveFileName(this, tr("Export profile"), "highlighting-profile.csv");
+    if (path.isEmpty()) return;
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        QMessageBox::warning(this, tr("Error"), tr("Can't save the file!") + "\n" + file.errorString(), QMessageBox::Ok);
+        return;
+    }
+
+    QTextStream stream(&file);
+    auto quoted = [](QString text) { return '"' + text.replace('"', "\"\"") + '"'; };
+    QStringList header;
+    for (int column = 0; column < table->columnCount(); ++column) header.append(quoted(table->horizontalHeaderItem(column)->text()));
+    stream << header.join(',') << '\n';
+    for (int row = 0; row < table->rowCount(); ++row)
+    {
+        QStringList fields;
+        for (int column = 0; column < table->columnCount(); ++column) fields.append(quoted(table->item(row, column)->text()));
+        stream << fields.join(',') << '\n';
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "LanguageRegistry.h"
+#include <QDialog>
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QPushButton>
+#include <QLabel>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+
+class RuleProfileDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit RuleProfileDialog(QWidget* parent = nullptr);
+
+signals:
+    void statsReset();
+
+public slots:
+    void refresh();
+
+private slots:
+    void reset();
+    void exportProfile();
+
+private:
+    void addRow(const QString&, const QString&, const RuleStats&, bool);
+
+    QTableWidget* table;
+    QLabel* status;
+    QPushButton* btnRefresh;
+    QPushButton* btnReset;
+    QPushButton* btnExport;
+};
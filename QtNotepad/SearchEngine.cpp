@@ -0,0 +1,168 @@
+#include "SearchEngine.h"
+#include <QRegularExpression>
+#include <QStringView>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAtomicInt>
+
+static const int batchSize = 4096;
+
+struct SearchJob
+{
+    QMutex mutex;
+    SearchEngine* engine;
+    QAtomicInt generation;
+};
+
+template <typename Callback>
+static bool scan(const QString& text, const SearchQuery& query, const QAtomicInt& generation, int current, Callback callback)
+{
+    if (query.regex)
+    {
+        QRegularExpression expression(query.pattern, QRegularExpression::MultilineOption | (query.sensitivity == Qt::CaseInsensitive
+            ? QRegularExpression::CaseInsensitiveOption : QRegularExpression::NoPatternOption));
+        expression.optimize();
+        QRegularExpressionMatchIterator iter = expression.globalMatch(text);
+        while (iter.hasNext())
+        {
+            if (generation.loadRelaxed() != current) return false;
+            QRegularExpressionMatch match = iter.next();
+            if (match.capturedLength() > 0) callback(match.capturedStart(), match.capturedLength(), &match);
+        }
+        return true;
+    }
+
+    QStringView view(text);
+    qsizetype length = query.pattern.size();
+    qsizetype i = view.indexOf(query.pattern, 0, query.sensitivity);
+    int checked = 0;
+    while (i >= 0)
+    {
+        if (++checked % batchSize == 0 && generation.loadRelaxed() != current) return false;
+        callback(int(i), int(length), nullptr);
+        i = view.indexOf(query.pattern, i + length, query.sensitivity);
+    }
+    return true;
+}
+
+static QString expand(const QRegularExpressionMatch& match, const QString& replacement)
+{
+    QString result;
+    for (int i = 0; i < replacement.size(); ++i)
+    {
+        QChar c = replacement.at(i);
+        if (c == '\\' && i + 1 < replacement.size())
+        {
+            QChar next = replacement.at(++i);
+            if (next.isDigit()) result.append(match.captured(next.digitValue()));
+            else if (next == 'n') result.append('\n');
+            else if (next == 't') result.append('\t');
+            else result.append(next);
+        }
+        else result.append(c);
+    }
+    return result;
+}
+
+SearchEngine::SearchEngine(QObject* parent) : QObject(parent), job(new SearchJob)
+{
+    job->engine = this;
+}
+
+SearchEngine::~SearchEngine()
+{
+    cancel();
+    {
+        QMutexLocker locker(&job->mutex);
+        job->engine = nullptr;
+    }
+    pool.waitForDone();
+}
+
+void SearchEngine::cancel()
+{
+    job->generation.fetchAndAddRelaxed(1);
+}
+
+QString SearchEngine::check(const SearchQuery& query)
+{
+    if (query.pattern.isEmpty()) return tr("Nothing to search for");
+    if (!query.regex) return QString();
+    QRegularExpression expression(query.pattern);
+    return expression.isValid() ? QString() : expression.errorString();
+}
+
+void SearchEngine::waitForDone()
+{
+    pool.waitForDone();
+}
+
+void SearchEngine::find(QObject* page, const QString& text, const SearchQuery& query)
+{
+    if (!check(query).isEmpty()) return;
+
+    QSharedPointer<SearchJob> shared = job;
+    int current = job->generation.loadRelaxed();
+    pool.start([shared, page, text, query, current]()
+    {
+        QVector<SearchMatch> batch;
+        int count = 0;
+        auto flush = [&shared, &batch, page, current]()
+        {
+            QMutexLocker locker(&shared->mutex);
+            SearchEngine* engine = shared->engine;
+            if (!engine || batch.isEmpty()) return;
+            QVector<SearchMatch> matches = batch;
+            QMetaObject::invokeMethod(engine, [shared, engine, page, matches, current]()
+            {
+                if (shared->generation.loadRelaxed() != current) return;
+                emit engine->found(page, matches);
+            }, Qt::QueuedConnection);
+            batch.clear();
+        };
+
+        bool complete = scan(text, query, shared->generation, current, [&](int position, int length, const QRegularExpressionMatch*)
+        {
+            batch.append({ position, length });
+            ++count;
+            if (batch.size() == batchSize) flush();
+        });
+        if (!complete) return;
+        flush();
+
+        QMutexLocker locker(&shared->mutex);
+        SearchEngine* engine = shared->engine;
+        if (!engine) return;
+        QMetaObject::invokeMethod(engine, [shared, engine, page, count, current]()
+        {
+            if (shared->generation.loadRelaxed() != current) return;
+            emit engine->finished(page, count);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void SearchEngine::replaceAll(QObject* page, const QString& text, const SearchQuery& query, const QString& replacement, int revision)
+{
+    if (!check(query).isEmpty()) return;
+
+    QSharedPointer<SearchJob> shared = job;
+    int current = job->generation.loadRelaxed();
+    pool.start([shared, page, text, query, replacement, revision, current]()
+    {
+        QVector<SearchReplacement> edits;
+        bool complete = scan(text, query, shared->generation, current, [&](int position, int length, const QRegularExpressionMatch* match)
+        {
+            edits.append({ position, length, match ? expand(*match, replacement) : replacement });
+        });
+        if (!complete) return;
+
+        QMutexLocker locker(&shared->mutex);
+        SearchEngine* engine = shared->engine;
+        if (!engine) return;
+        QMetaObject::invokeMethod(engine, [shared, engine, page, edits, revision, current]()
+        {
+            if (shared->generation.loadRelaxed() != current) return;
+            emit engine->replaced(page, edits, revision);
+        }, Qt::QueuedConnection);
+    });
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QThreadPool>
+#include <QSharedPointer>
+
+struct SearchJob;
+
+struct SearchMatch
+{
+    int position;
+    int length;
+};
+
+struct SearchReplacement
+{
+    int position;
+    int length;
+    QString text;
+};
+
+struct SearchQuery
+{
+    QString pattern;
+    bool regex = false;
+    Qt::CaseSensitivity sensitivity = Qt::CaseInsensitive;
+};
+
+class SearchEngine : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SearchEngine(QObject* parent = nullptr);
+    ~SearchEngine();
+
+    static QString check(const SearchQuery&);
+
+    void find(QObject*, const QString&, const SearchQuery&);
+    void replaceAll(QObject*, const QString&, const SearchQuery&, const QString&, int);
+    void cancel();
+    void waitForDone();
+
+signals:
+    void found(QObject*, const QVector<SearchMatch>&);
+    void finished(QObject*, int);
+    void replaced(QObject*, const QVector<SearchReplacement>&, int);
+
+private:
+    QThreadPool pool;
+    QSharedPointer<SearchJob> job;
+};
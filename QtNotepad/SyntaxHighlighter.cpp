@@ -1,95 +1,283 @@
 #include "SyntaxHighlighter.h"
-SyntaxHighlighter::SyntaxHighlighter(const QString& str, QTextDocument* parent, const QString& style) : QSyntaxHighlighter(parent)
+#include "Trace.h"
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
+#include <climits>
+
+static const int syncBlockLimit = 200;
+static const int chunkBlocks = 512;
+static const int chunkChars = 64 * 1024;
+static const int idleDelay = 500;
+
+// userState() of a block: -1 until processed, otherwise the multi-line comment state.
+// Blocks whose state is known but which were not formatted carry unformattedFlag.
+static const int unformattedFlag = 0x100;
+
+static inline int blockState(int userState)
+{
+    return userState == -1 ? -1 : userState & ~unformattedFlag;
+}
+
+struct HighlightJob
+{
+    QMutex mutex;
+    SyntaxHighlighter* highlighter;
+};
+
+SyntaxHighlighter::SyntaxHighlighter(const QString& str, QTextDocument* parent, const QString& style) : QObject(parent),
+    document(parent), job(new HighlightJob), generation(0), pendingFrom(0), idleFrom(0), blockCount(0),
+    visibleFirst(0), visibleLast(-1), margin(100), lazy(false), idle(false), busy(false)
 {
-    multiLineCommentFormat.setForeground(QColor(0, 255, 255));
-    supported = true;
+    job->highlighter = this;
+    idleTimer = new QTimer(this);
+    idleTimer->setSingleShot(true);
+    idleTimer->setInterval(idleDelay);
+    connect(idleTimer, SIGNAL(timeout()), SLOT(startIdle()));
 
-    QDomDocument domDocument;
-    QFile file(style);
-    QTextCharFormat textCharFormat;
-    HighlightingRule rule;
-    int errorColumn;
-    int errorRow;
-    QString errorStr;
+    if (!str.isEmpty()) language = LanguageRegistry::instance().definition(str, style);
+    if (!language || !document) return;
+
+    blockCount = document->blockCount();
+    connect(document, SIGNAL(contentsChange(int, int, int)), SLOT(reformatBlocks(int, int, int)));
+    scheduleNext();
+}
 
-    if (file.open(QIODevice::ReadOnly))
+SyntaxHighlighter::~SyntaxHighlighter()
+{
+    QMutexLocker locker(&job->mutex);
+    job->highlighter = nullptr;
+}
+
+bool SyntaxHighlighter::isSupported()
+{
+    return !language.isNull();
+}
+
+void SyntaxHighlighter::setLazy(bool enabled, int blocks)
+{
+    lazy = enabled;
+    margin = qMax(0, blocks);
+    markActivity();
+}
+
+void SyntaxHighlighter::setVisibleBlocks(int first, int last)
+{
+    visibleFirst = first;
+    visibleLast = last;
+    markActivity();
+    scheduleNext();
+}
+
+void SyntaxHighlighter::rehighlight()
+{
+    if (!language) return;
+    ++generation;
+    pendingFrom = 0;
+    idleFrom = 0;
+    markActivity();
+    scheduleNext();
+}
+
+void SyntaxHighlighter::markActivity()
+{
+    idle = false;
+    if (lazy) idleTimer->start();
+}
+
+void SyntaxHighlighter::startIdle()
+{
+    idle = true;
+    scheduleNext();
+}
+
+void SyntaxHighlighter::reformatBlocks(int position, int, int added)
+{
+    TRACE_SCOPE("SyntaxHighlighter::reformatBlocks");
+    ++generation;
+    markActivity();
+    int blockDelta = document->blockCount() - blockCount;
+    blockCount = document->blockCount();
+
+    QTextBlock block = document->findBlock(position);
+    QTextBlock last = document->findBlock(position + added);
+    if (!last.isValid()) last = document->lastBlock();
+    int first = block.blockNumber();
+    int lastNumber = last.blockNumber();
+
+    if (pendingFrom > first) pendingFrom = qMax(lastNumber + 1, pendingFrom + blockDelta);
+    idleFrom = qMin(idleFrom, first);
+    if (lastNumber - first >= syncBlockLimit)
     {
-        if (domDocument.setContent(&file, &errorStr, &errorRow, &errorColumn))
+        pendingFrom = qMin(pendingFrom, first);
+        scheduleNext();
+        return;
+    }
+
+    int state = blockState(block.previous().userState());
+    int processed = 0;
+    bool changed = false;
+    while (block.isValid())
+    {
+        int number = block.blockNumber();
+        if (number > lastNumber && (!changed || number >= pendingFrom)) break;
+        if (number > lastNumber && processed >= syncBlockLimit)
+        {
+            pendingFrom = number;
+            break;
+        }
+        QVector<QTextLayout::FormatRange> formats;
+        int oldState = blockState(block.userState());
+        state = language->highlightLine(block.text(), state, formats);
+        applyFormats(block, formats, state);
+        changed = oldState != state;
+        ++processed;
+        block = block.next();
+    }
+    reportDisabledRules();
+    scheduleNext();
+}
+
+void SyntaxHighlighter::applyFormats(QTextBlock& block, const QVector<QTextLayout::FormatRange>& formats, int state)
+{
+    block.layout()->setFormats(formats);
+    block.setUserState(state);
+    document->markContentsDirty(block.position(), block.length());
+}
+
+void SyntaxHighlighter::applyResult(const HighlightResult& result)
+{
+    TRACE_SCOPE("SyntaxHighlighter::applyResult");
+    busy = false;
+    if (result.generation == generation)
+    {
+        QTextBlock block = document->findBlockByNumber(result.firstBlock);
+        int start = -1;
+        int end = -1;
+        for (int i = 0; i < result.states.size() && block.isValid(); ++i)
         {
-            QDomElement root = domDocument.documentElement();
-            auto nodes = root.elementsByTagName("syntax");
-            if (!nodes.isEmpty())
+            int state = result.states.at(i);
+            if (!(state & unformattedFlag))
             {
-                for (auto i = 0; i < nodes.count(); ++i)
-                {
-                    QStringList list = nodes.item(i).toElement().attribute("list").split(QRegularExpression("\\s+"));
-                    if ((list.contains(str)) && (str != Q_NULLPTR))
-                    {
-                        auto ruleNodes = nodes.item(i).toElement().elementsByTagName("rule");
-                        if (!ruleNodes.isEmpty())
-                        {
-                            for (int j = 0; j < ruleNodes.count(); ++j)
-                            {
-                                auto format = ruleNodes.item(j).toElement().elementsByTagName("format");
-                                auto pattern = ruleNodes.item(j).toElement().elementsByTagName("pattern");
-                                rule.pattern = QRegularExpression(pattern.item(0).toElement().attribute("value"));
-                                rule.format.setFontWeight(format.at(0).toElement().attribute("font_weight").toInt());
-                                rule.format.setForeground(QColor(format.item(0).toElement().attribute("foreground")));
-                                rules.append(rule);
-                            }
-                        }
-                        auto first = root.elementsByTagName("startComment").item(0).toElement();
-                        auto last = root.elementsByTagName("endComment").item(0).toElement();
-                        QString firstNode = first.elementsByTagName("pattern").at(0).toElement().attribute("value");
-                        QString lastNode = last.elementsByTagName("pattern").at(0).toElement().attribute("value");
-
-                        commentStartExpression = QRegularExpression(firstNode);
-                        commentEndExpression = QRegularExpression(lastNode);
-                    }
-                    else supported = false;
-                }
+                block.layout()->setFormats(result.formats.at(i));
+                if (start == -1) start = block.position();
+                end = block.position() + block.length();
             }
+            block.setUserState(state);
+            block = block.next();
         }
-        else qDebug() << errorStr
-            << " Error string " << errorRow
-            << " Error column " << errorColumn;
+        if (start != -1) document->markContentsDirty(start, end - start);
+        if (result.sequential) pendingFrom = result.firstBlock + result.states.size();
     }
-    else qDebug() << "Can't open XML file!";
+    reportDisabledRules();
+    scheduleNext();
 }
 
-bool SyntaxHighlighter::isSupported()
+void SyntaxHighlighter::reportDisabledRules()
 {
-    return supported;
+    QStringList patterns;
+    for (const HighlightingRule& rule : language->rules)
+    {
+        if (rule.stats->disabled.loadRelaxed() && rule.stats->reported.testAndSetRelaxed(0, 1))
+            patterns.append(rule.pattern.pattern());
+    }
+    if (!patterns.isEmpty()) emit rulesDisabled(patterns);
+}
+
+int SyntaxHighlighter::firstUnformatted(int from, int to)
+{
+    QTextBlock block = document->findBlockByNumber(from);
+    for (int number = from; block.isValid() && number <= to; ++number)
+    {
+        int state = block.userState();
+        if (state == -1 || (state & unformattedFlag)) return number;
+        block = block.next();
+    }
+    return -1;
 }
 
-void SyntaxHighlighter::highlightBlock(const QString& txt)
+void SyntaxHighlighter::scheduleNext()
 {
-    for (const HighlightingRule& rule : qAsConst(rules))
+    if (busy || !language) return;
+
+    int count = document->blockCount();
+    int first = -1;
+    int last = -1;
+    int formatFirst = 0;
+    int formatLast = INT_MAX;
+    bool sequential = false;
+
+    if (visibleLast >= 0)
     {
-        QRegularExpressionMatchIterator iter = rule.pattern.globalMatch(txt);
-        while (iter.hasNext())
+        last = qMin(visibleLast, count - 1);
+        first = firstUnformatted(visibleFirst, last);
+        if (first == -1 && lazy)
         {
-            QRegularExpressionMatch match = iter.next();
-            setFormat(match.capturedStart(), match.capturedLength(), rule.format);
+            last = qMin(visibleLast + margin, count - 1);
+            first = firstUnformatted(qMax(0, visibleFirst - margin), last);
         }
     }
+    if (first == -1 && pendingFrom < count)
+    {
+        first = pendingFrom;
+        last = count - 1;
+        sequential = true;
+        if (lazy)
+        {
+            formatFirst = visibleLast >= 0 ? qMax(0, visibleFirst - margin) : 0;
+            formatLast = visibleLast >= 0 ? visibleLast + margin : margin;
+        }
+    }
+    if (first == -1 && lazy && idle && idleFrom < count)
+    {
+        first = firstUnformatted(idleFrom, count - 1);
+        last = count - 1;
+        idleFrom = first == -1 ? count : first;
+    }
+    if (first == -1) return;
 
-    setCurrentBlockState(0);
-    int first = 0;
-    if (previousBlockState() != 1) first = txt.indexOf(commentStartExpression);
+    QTextBlock block = document->findBlockByNumber(first);
+    int startState = blockState(block.previous().userState());
+    QStringList texts;
+    int chars = 0;
+    while (block.isValid() && first + texts.size() <= last && texts.size() < chunkBlocks && chars < chunkChars)
+    {
+        texts.append(block.text());
+        chars += block.length();
+        block = block.next();
+    }
 
-    while (first >= 0)
+    busy = true;
+    int requestGeneration = generation;
+    QSharedPointer<const LanguageDefinition> definition = language;
+    QSharedPointer<HighlightJob> shared = job;
+    QThreadPool::globalInstance()->start([=]()
     {
-        QRegularExpressionMatch match = commentEndExpression.match(txt, first);
-        int last = match.capturedStart();
-        int length = 0;
-        if (last == -1)
+        TRACE_SCOPE("SyntaxHighlighter::highlightChunk");
+        HighlightResult result;
+        result.generation = requestGeneration;
+        result.firstBlock = first;
+        result.sequential = sequential;
+        int state = startState;
+        for (int i = 0; i < texts.size(); ++i)
         {
-            setCurrentBlockState(1);
-            length = txt.length() - first;
+            QVector<QTextLayout::FormatRange> formats;
+            int number = first + i;
+            if (number >= formatFirst && number <= formatLast)
+            {
+                state = definition->highlightLine(texts.at(i), state, formats);
+                result.states.append(state);
+            }
+            else
+            {
+                state = definition->lineState(texts.at(i), state);
+                result.states.append(state | unformattedFlag);
+            }
+            result.formats.append(formats);
         }
-        else length = last - first + match.capturedLength();
-        setFormat(first, length, multiLineCommentFormat);
-        first = txt.indexOf(commentStartExpression, length + first);
-    }
-}
\ No newline at end of file
+
+        QMutexLocker locker(&shared->mutex);
+        if (SyntaxHighlighter* highlighter = shared->highlighter)
+            QMetaObject::invokeMethod(highlighter, [highlighter, result]() { highlighter->applyResult(result); }, Qt::QueuedConnection);
+    });
+}
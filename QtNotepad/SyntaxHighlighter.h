@@ -1,33 +1,64 @@
 #pragma once
-#include <QSyntaxHighlighter>
-#include <QRegularExpression>
-#include <QDomDocument>
-#include <QFile>
-#include <QFileInfo>
+#include "LanguageRegistry.h"
+#include <QObject>
+#include <QTextDocument>
+#include <QTextBlock>
+#include <QTextLayout>
+#include <QTimer>
 
-struct HighlightingRule
+struct HighlightJob;
+
+struct HighlightResult
 {
-    QRegularExpression pattern;
-    QTextCharFormat format;
+    int generation;
+    int firstBlock;
+    bool sequential;
+    QVector<QVector<QTextLayout::FormatRange>> formats;
+    QVector<int> states;
 };
 
-class SyntaxHighlighter : public QSyntaxHighlighter
+class SyntaxHighlighter : public QObject
 {
     Q_OBJECT
 public:
     SyntaxHighlighter(const QString&,
         QTextDocument* parent = nullptr,
         const QString& style_filename = ":/settings/styles.xml");
+    ~SyntaxHighlighter();
     bool isSupported();
+    void setLazy(bool, int margin = 100);
+
+signals:
+    void rulesDisabled(const QStringList&);
+
+public slots:
+    void setVisibleBlocks(int, int);
+    void rehighlight();
 
-protected:
-    void highlightBlock(const QString& text) override;
+private slots:
+    void reformatBlocks(int, int, int);
+    void startIdle();
 
 private:
-    QVector<HighlightingRule> rules;
-    bool supported;
-    QTextCharFormat multiLineCommentFormat;
-    QRegularExpression commentStartExpression;
-    QRegularExpression commentEndExpression;
-};
+    void applyFormats(QTextBlock&, const QVector<QTextLayout::FormatRange>&, int);
+    void applyResult(const HighlightResult&);
+    void scheduleNext();
+    void markActivity();
+    void reportDisabledRules();
+    int firstUnformatted(int, int);
 
+    QTextDocument* document;
+    QSharedPointer<const LanguageDefinition> language;
+    QSharedPointer<HighlightJob> job;
+    QTimer* idleTimer;
+    int generation;
+    int pendingFrom;
+    int idleFrom;
+    int blockCount;
+    int visibleFirst;
+    int visibleLast;
+    int margin;
+    bool lazy;
+    bool idle;
+    bool busy;
+};
@@ -0,0 +1,97 @@
+#include "TabPlaceholder.h"
+
+TabPlaceholder::TabPlaceholder(const QString& path, QWidget* parent) : QLabel(parent),
+    filePath(path), cursor(-1), scroll(-1), loaded(false), stored(false)
+{
+    setAlignment(Qt::AlignCenter);
+    setText(tr("Loading %1...").arg(path));
+}
+
+QString TabPlaceholder::path() const
+{
+    return filePath;
+}
+
+bool TabPlaceholder::hasContents() const
+{
+    return loaded;
+}
+
+void TabPlaceholder::setContents(const QString& text)
+{
+    contents = text;
+    loaded = true;
+}
+
+QString TabPlaceholder::takeContents()
+{
+    QString text = contents;
+    contents.clear();
+    loaded = false;
+    return text;
+}
+
+bool TabPlaceholder::hasSnapshot() const
+{
+    return stored;
+}
+
+void TabPlaceholder::setSnapshot(const QString& text)
+{
+    snapshot = qCompress(text.toUtf8());
+    stored = true;
+}
+
+QString TabPlaceholder::snapshotText() const
+{
+    return QString::fromUtf8(qUncompress(snapshot));
+}
+
+QString TabPlaceholder::takeSnapshot()
+{
+    QString text = snapshotText();
+    snapshot.clear();
+    stored = false;
+    return text;
+}
+
+TextFormat TabPlaceholder::textFormat() const
+{
+    return format;
+}
+
+void TabPlaceholder::setTextFormat(const TextFormat& textFormat)
+{
+    format = textFormat;
+}
+
+ContentDigest TabPlaceholder::contentDigest() const
+{
+    return digest;
+}
+
+void TabPlaceholder::setContentDigest(const ContentDigest& contentDigest)
+{
+    digest = contentDigest;
+}
+
+void TabPlaceholder::setViewState(int position, int value)
+{
+    cursor = position;
+    scroll = value;
+}
+
+int TabPlaceholder::cursorPosition() const
+{
+    return cursor;
+}
+
+int TabPlaceholder::scrollPosition() const
+{
+    return scroll;
+}
+
+qint64 TabPlaceholder::memoryUsage() const
+{
+    return contents.size() * qint64(sizeof(QChar)) + snapshot.size();
+}
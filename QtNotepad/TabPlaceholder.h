@@ -0,0 +1,45 @@
+#pragma once
+#include "FileCodec.h"
+#include "ContentHash.h"
+#include <QLabel>
+#include <QString>
+#include <QByteArray>
+
+class TabPlaceholder : public QLabel
+{
+    Q_OBJECT
+public:
+    explicit TabPlaceholder(const QString&, QWidget* parent = nullptr);
+
+    QString path() const;
+    bool hasContents() const;
+    void setContents(const QString&);
+    QString takeContents();
+
+    bool hasSnapshot() const;
+    void setSnapshot(const QString&);
+    QString snapshotText() const;
+    QString takeSnapshot();
+
+    TextFormat textFormat() const;
+    void setTextFormat(const TextFormat&);
+    ContentDigest contentDigest() const;
+    void setContentDigest(const ContentDigest&);
+
+    void setViewState(int, int);
+    int cursorPosition() const;
+    int scrollPosition() const;
+
+    qint64 memoryUsage() const;
+
+private:
+    QString filePath;
+    QString contents;
+    QByteArray snapshot;
+    TextFormat format;
+    ContentDigest digest;
+    int cursor;
+    int scroll;
+    bool loaded;
+    bool stored;
+};
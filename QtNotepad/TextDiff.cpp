@@ -0,0 +1,87 @@
+#include "TextDiff.h"
+#include <QStringView>
+#include <QHash>
+
+static const qint64 maxTable = 1 << 22;
+
+struct Lines
+{
+    QStringView text;
+    QVector<int> offsets;
+    QVector<size_t> hashes;
+
+    explicit Lines(const QString& source) : text(source)
+    {
+        offsets.append(0);
+        for (int i = 0; i < text.size(); ++i)
+            if (text.at(i) == '\n' && i + 1 < text.size()) offsets.append(i + 1);
+        if (text.isEmpty()) offsets.clear();
+        offsets.append(text.size());
+
+        hashes.reserve(count());
+        for (int i = 0; i < count(); ++i) hashes.append(qHash(line(i)));
+    }
+
+    int count() const { return offsets.size() - 1; }
+    QStringView line(int i) const { return text.mid(offsets.at(i), offsets.at(i + 1) - offsets.at(i)); }
+};
+
+static bool same(const Lines& a, int i, const Lines& b, int j)
+{
+    return a.hashes.at(i) == b.hashes.at(j) && a.line(i) == b.line(j);
+}
+
+static void addHunk(QVector<DiffHunk>& hunks, const Lines& before, int from, int count, const Lines& after, int to, int added)
+{
+    if (count == 0 && added == 0) return;
+    int position = before.offsets.at(from);
+    int length = before.offsets.at(from + count) - position;
+    int start = after.offsets.at(to);
+    hunks.append({ position, length, after.text.mid(start, after.offsets.at(to + added) - start).toString() });
+}
+
+QVector<DiffHunk> diffLines(const QString& beforeText, const QString& afterText)
+{
+    Lines before(beforeText);
+    Lines after(afterText);
+    QVector<DiffHunk> hunks;
+
+    int prefix = 0;
+    while (prefix < before.count() && prefix < after.count() && same(before, prefix, after, prefix)) ++prefix;
+    int suffix = 0;
+    while (suffix < before.count() - prefix && suffix < after.count() - prefix
+        && same(before, before.count() - 1 - suffix, after, after.count() - 1 - suffix)) ++suffix;
+
+    int n = before.count() - prefix - suffix;
+    int m = after.count() - prefix - suffix;
+    if (n == 0 && m == 0) return hunks;
+    if (n == 0 || m == 0 || qint64(n + 1) * (m + 1) > maxTable)
+    {
+        addHunk(hunks, before, prefix, n, after, prefix, m);
+        return hunks;
+    }
+
+    QVector<int> table((n + 1) * (m + 1), 0);
+    auto cell = [&table, m](int i, int j) -> int& { return table[i * (m + 1) + j]; };
+    for (int i = n - 1; i >= 0; --i)
+        for (int j = m - 1; j >= 0; --j)
+            cell(i, j) = same(before, prefix + i, after, prefix + j) ? cell(i + 1, j + 1) + 1 : qMax(cell(i + 1, j), cell(i, j + 1));
+
+    int i = 0;
+    int j = 0;
+    int hunkI = 0;
+    int hunkJ = 0;
+    while (i < n || j < m)
+    {
+        if (i < n && j < m && same(before, prefix + i, after, prefix + j))
+        {
+            addHunk(hunks, before, prefix + hunkI, i - hunkI, after, prefix + hunkJ, j - hunkJ);
+            hunkI = ++i;
+            hunkJ = ++j;
+        }
+        else if (j < m && (i == n || cell(i, j + 1) >= cell(i + 1, j))) ++j;
+        else ++i;
+    }
+    addHunk(hunks, before, prefix + hunkI, i - hunkI, after, prefix + hunkJ, j - hunkJ);
+    return hunks;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <QString>
+#include <QVector>
+
+struct DiffHunk
+{
+    int position;
+    int length;
+    QString text;
+};
+
+QVector<DiffHunk> diffLines(const QString&, const QString&);
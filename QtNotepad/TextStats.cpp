@@ -0,0 +1,100 @@
+#include "TextStats.h"
+#include "BlockChange.h"
+#include "Trace.h"
+
+TextStats::TextStats(QTextDocument* textDocument, QObject* parent) : QObject(parent),
+    document(textDocument), treeValid(false), total(0)
+{
+    rebuild();
+    connect(document, SIGNAL(contentsChange(int, int, int)), SLOT(contentsChange(int, int, int)));
+}
+
+int TextStats::countWords(QStringView text)
+{
+    int words = 0;
+    bool inWord = false;
+    for (QChar c : text)
+    {
+        bool space = c.isSpace();
+        if (!space && !inWord) ++words;
+        inWord = !space;
+    }
+    return words;
+}
+
+qint64 TextStats::words() const
+{
+    return total;
+}
+
+// Range sums come from a Fenwick tree over counts. Edits that keep the line
+// count patch it in place; edits that add or remove lines invalidate it and
+// the next query rebuilds it in one linear pass.
+qint64 TextStats::words(int from, int to) const
+{
+    from = qMax(0, from);
+    to = qMin(to, int(counts.size()));
+    if (from >= to) return 0;
+    if (!treeValid)
+    {
+        tree.fill(0, counts.size() + 1);
+        for (int i = 1; i <= counts.size(); ++i)
+        {
+            tree[i] += counts.at(i - 1);
+            int parent = i + (i & -i);
+            if (parent <= counts.size()) tree[parent] += tree.at(i);
+        }
+        treeValid = true;
+    }
+    return prefix(to) - prefix(from);
+}
+
+qint64 TextStats::prefix(int end) const
+{
+    qint64 sum = 0;
+    for (int i = end; i > 0; i -= i & -i) sum += tree.at(i);
+    return sum;
+}
+
+void TextStats::addToTree(int index, qint64 delta)
+{
+    if (!treeValid || !delta) return;
+    for (int i = index + 1; i < tree.size(); i += i & -i) tree[i] += delta;
+}
+
+void TextStats::rebuild()
+{
+    counts.clear();
+    counts.reserve(document->blockCount());
+    treeValid = false;
+    total = 0;
+    for (QTextBlock block = document->begin(); block.isValid(); block = block.next())
+    {
+        counts.append(countWords(block.text()));
+        total += counts.last();
+    }
+}
+
+void TextStats::contentsChange(int position, int, int added)
+{
+    TRACE_SCOPE("TextStats::contentsChange");
+    BlockChange change;
+    if (!change.map(document, position, added, counts.size()))
+    {
+        rebuild();
+        return;
+    }
+
+    for (int i = change.first; i <= change.oldLast; ++i) total -= counts.at(i);
+    if (change.oldLast != change.last) treeValid = false;
+    change.resize(counts);
+
+    QTextBlock block = change.firstBlock;
+    for (int i = change.first; i <= change.last; ++i, block = block.next())
+    {
+        int count = countWords(block.text());
+        addToTree(i, count - counts.at(i));
+        counts[i] = count;
+        total += count;
+    }
+}
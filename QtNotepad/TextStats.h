@@ -0,0 +1,30 @@
+#pragma once
+#include <QObject>
+#include <QTextDocument>
+#include <QStringView>
+#include <QVector>
+
+class TextStats : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TextStats(QTextDocument*, QObject* parent = nullptr);
+
+    qint64 words() const;
+    qint64 words(int, int) const;
+    static int countWords(QStringView);
+
+private slots:
+    void contentsChange(int, int, int);
+
+private:
+    void rebuild();
+    void addToTree(int, qint64);
+    qint64 prefix(int) const;
+
+    QTextDocument* document;
+    QVector<int> counts;
+    mutable QVector<qint64> tree;
+    mutable bool treeValid;
+    qint64 total;
+};
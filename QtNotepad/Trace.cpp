@@ -0,0 +1,159 @@
+#include "Trace.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <memory>
+
+static const quint64 bufferCapacity = 1 << 16;
+
+struct TraceEvent
+{
+    const char* name;
+    qint64 start;
+    qint64 end;
+    int tid;
+};
+
+// Each thread appends to its own buffer, so its lock is only contended while
+// the trace is exported; the oldest events are overwritten once a buffer wraps
+// around. A buffer goes back to the registry when its thread exits and is
+// reused by the next new thread, so threads that come and go in the pool do
+// not each keep a buffer alive.
+struct TraceBuffer
+{
+    QMutex mutex;
+    TraceEvent events[bufferCapacity];
+    quint64 head = 0;
+};
+
+struct TraceRegistry
+{
+    QMutex mutex;
+    QVector<std::shared_ptr<TraceBuffer>> buffers;
+    QVector<TraceBuffer*> idle;
+    QStringList threads;
+    QElapsedTimer clock;
+    QString path;
+};
+
+struct TraceThread
+{
+    TraceBuffer* buffer = nullptr;
+    int tid = 0;
+    ~TraceThread();
+};
+
+QAtomicInt Trace::enabled;
+
+static TraceRegistry& registry()
+{
+    static TraceRegistry instance;
+    return instance;
+}
+
+TraceThread::~TraceThread()
+{
+    if (!buffer) return;
+    TraceRegistry& traces = registry();
+    QMutexLocker locker(&traces.mutex);
+    traces.idle.append(buffer);
+}
+
+static TraceThread& threadState()
+{
+    thread_local TraceThread state;
+    if (state.buffer) return state;
+
+    TraceRegistry& traces = registry();
+    QMutexLocker locker(&traces.mutex);
+    if (traces.idle.isEmpty())
+    {
+        traces.buffers.append(std::make_shared<TraceBuffer>());
+        state.buffer = traces.buffers.last().get();
+    }
+    else
+    {
+        state.buffer = traces.idle.takeLast();
+    }
+    state.tid = traces.threads.size() + 1;
+    QThread* thread = QThread::currentThread();
+    if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) traces.threads.append("Main");
+    else if (!thread->objectName().isEmpty()) traces.threads.append(thread->objectName());
+    else traces.threads.append(QString("Worker %1").arg(state.tid));
+    return state;
+}
+
+bool Trace::start(const QString& path)
+{
+    if (path.isEmpty()) return false;
+    TraceRegistry& traces = registry();
+    traces.path = path;
+    traces.clock.start();
+    enabled.storeRelease(1);
+    return true;
+}
+
+qint64 Trace::now()
+{
+    return registry().clock.nsecsElapsed();
+}
+
+void Trace::record(const char* name, qint64 start, qint64 end)
+{
+    if (!isEnabled()) return;
+    TraceThread& state = threadState();
+    QMutexLocker locker(&state.buffer->mutex);
+    TraceEvent& event = state.buffer->events[state.buffer->head++ % bufferCapacity];
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    event.tid = state.tid;
+}
+
+static QByteArray escaped(const QString& text)
+{
+    QByteArray bytes = text.toUtf8();
+    bytes.replace('\\', "\\\\").replace('"', "\\\"");
+    return bytes;
+}
+
+bool Trace::write()
+{
+    if (!isEnabled()) return false;
+    enabled.storeRelease(0);
+
+    TraceRegistry& traces = registry();
+    QMutexLocker locker(&traces.mutex);
+    QFile file(traces.path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    QVector<TraceEvent> events;
+    for (const std::shared_ptr<TraceBuffer>& buffer : qAsConst(traces.buffers))
+    {
+        QMutexLocker bufferLocker(&buffer->mutex);
+        quint64 begin = buffer->head > bufferCapacity ? buffer->head - bufferCapacity : 0;
+        for (quint64 i = begin; i < buffer->head; ++i) events.append(buffer->events[i % bufferCapacity]);
+    }
+
+    QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    file.write("{\"traceEvents\":[\n");
+    for (int i = 0; i < traces.threads.size(); ++i)
+    {
+        file.write(i ? ",\n" : "");
+        file.write("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + QByteArray::number(i + 1)
+            + ",\"args\":{\"name\":\"" + escaped(traces.threads.at(i)) + "\"}}");
+    }
+    for (const TraceEvent& event : qAsConst(events))
+    {
+        file.write(",\n{\"name\":\"" + escaped(QString::fromLatin1(event.name)) + "\",\"ph\":\"X\",\"pid\":" + pid
+            + ",\"tid\":" + QByteArray::number(event.tid) + ",\"ts\":" + QByteArray::number(event.start / 1000.0, 'f', 3)
+            + ",\"dur\":" + QByteArray::number((event.end - event.start) / 1000.0, 'f', 3) + "}");
+    }
+    file.write("\n],\"displayTimeUnit\":\"ms\"}\n");
+    return file.error() == QFileDevice::NoError;
+}
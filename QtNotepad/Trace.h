@@ -0,0 +1,37 @@
+#pragma once
+#include <QString>
+#include <QAtomicInt>
+
+class Trace
+{
+public:
+    static bool start(const QString&);
+    static bool write();
+    static bool isEnabled() { return enabled.loadRelaxed() != 0; }
+    static qint64 now();
+    static void record(const char*, qint64, qint64);
+
+    class Scope
+    {
+    public:
+        explicit Scope(const char* span) : name(span), begin(Trace::isEnabled() ? Trace::now() : -1) {}
+        ~Scope() { if (begin >= 0) Trace::record(name, begin, Trace::now()); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+        qint64 begin;
+    };
+
+private:
+    static QAtomicInt enabled;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#ifdef QTNOTEPAD_NO_TRACE
+#define TRACE_SCOPE(name)
+#else
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#endif
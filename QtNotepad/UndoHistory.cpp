@@ -0,0 +1,193 @@
+#include "UndoHistory.h"
+#include <QTextCursor>
+#include <QDir>
+#include <QPointer>
+#include <QThreadPool>
+#include <QCoreApplication>
+
+static const qint64 commandOverhead = 64;
+
+qint64 UndoHistory::globalBudget = 256 * 1024 * 1024;
+qint64 UndoHistory::globalStored = 0;
+
+UndoHistory::UndoHistory(QTextDocument* parentDocument, QObject* parent) : QObject(parent),
+    document(parentDocument), spillFile(nullptr), budget(32 * 1024 * 1024), live(0), stored(0), spilled(0), serials(0), restoring(false), trimming(false)
+{
+    connect(document, SIGNAL(contentsChange(int, int, int)), SLOT(recordChange(int, int, int)));
+}
+
+UndoHistory::~UndoHistory()
+{
+    globalStored -= stored;
+}
+
+void UndoHistory::setBudget(qint64 bytes)
+{
+    budget = bytes;
+}
+
+void UndoHistory::setGlobalBudget(qint64 bytes)
+{
+    globalBudget = bytes;
+}
+
+qint64 UndoHistory::liveBytes() const
+{
+    return live;
+}
+
+qint64 UndoHistory::storedBytes() const
+{
+    return stored;
+}
+
+qint64 UndoHistory::spilledBytes() const
+{
+    return spilled;
+}
+
+int UndoHistory::checkpointCount() const
+{
+    return checkpoints.size();
+}
+
+qint64 UndoHistory::globalStoredBytes()
+{
+    return globalStored;
+}
+
+void UndoHistory::recordChange(int, int removed, int added)
+{
+    if (restoring || !document->isUndoRedoEnabled()) return;
+    if (document->availableUndoSteps() == 0 && document->availableRedoSteps() == 0)
+    {
+        live = 0;
+        return;
+    }
+    live += (qint64(removed) + added) * qint64(sizeof(QChar)) + commandOverhead;
+    if (live <= budget || trimming) return;
+    trimming = true;
+    QMetaObject::invokeMethod(this, "trim", Qt::QueuedConnection);
+}
+
+void UndoHistory::trim()
+{
+    trimming = false;
+    if (live <= budget || !document->isUndoAvailable()) return;
+
+    // Step back over the newest edit once so it stays undoable: only the
+    // steps before it are dropped from the native stacks.
+    bool based = !checkpoints.isEmpty() && document->availableUndoSteps() == 1;
+    restoring = true;
+    document->undo();
+    QString before = document->toRawText();
+    document->redo();
+    restoring = false;
+
+    QString after = document->toRawText();
+    document->clearUndoRedoStacks();
+    live = 0;
+    if (!based) addCheckpoint(before);
+    addCheckpoint(after);
+}
+
+void UndoHistory::addCheckpoint(const QString& text)
+{
+    int serial = ++serials;
+    checkpoints.append({ QByteArray(), -1, 0, serial, text });
+
+    QPointer<UndoHistory> self(this);
+    QThreadPool::globalInstance()->start([self, serial, text]()
+    {
+        QByteArray data = qCompress(text.toUtf8(), 1);
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [self, serial, data]()
+        {
+            if (self) self->compressed(serial, data);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void UndoHistory::compressed(int serial, const QByteArray& data)
+{
+    for (Checkpoint& checkpoint : checkpoints)
+    {
+        if (checkpoint.serial != serial) continue;
+        checkpoint.data = data;
+        checkpoint.size = data.size();
+        checkpoint.text.clear();
+        stored += data.size();
+        globalStored += data.size();
+        if (globalStored > globalBudget) spill();
+        return;
+    }
+}
+
+void UndoHistory::spill()
+{
+    if (!spillFile)
+    {
+        spillFile = new QTemporaryFile(QDir::tempPath() + "/QtNotepad-undo-XXXXXX", this);
+        if (!spillFile->open())
+        {
+            delete spillFile;
+            spillFile = nullptr;
+            return;
+        }
+    }
+
+    for (Checkpoint& checkpoint : checkpoints)
+    {
+        if (checkpoint.offset >= 0 || checkpoint.data.isEmpty()) continue;
+        qint64 offset = spillFile->size();
+        spillFile->seek(offset);
+        if (spillFile->write(checkpoint.data) != checkpoint.data.size()) return;
+        checkpoint.offset = offset;
+        stored -= checkpoint.size;
+        globalStored -= checkpoint.size;
+        spilled += checkpoint.size;
+        checkpoint.data.clear();
+    }
+}
+
+QString UndoHistory::checkpointText(const Checkpoint& checkpoint)
+{
+    if (checkpoint.data.isEmpty() && checkpoint.offset < 0) return checkpoint.text;
+    if (checkpoint.offset < 0) return QString::fromUtf8(qUncompress(checkpoint.data));
+    if (!spillFile || !spillFile->seek(checkpoint.offset)) return QString();
+    return QString::fromUtf8(qUncompress(spillFile->read(checkpoint.size)));
+}
+
+void UndoHistory::dropCheckpoint()
+{
+    Checkpoint checkpoint = checkpoints.takeLast();
+    if (checkpoint.offset < 0)
+    {
+        stored -= checkpoint.size;
+        globalStored -= checkpoint.size;
+    }
+    else spilled -= checkpoint.size;
+}
+
+bool UndoHistory::canUndo() const
+{
+    return checkpoints.size() > 1;
+}
+
+bool UndoHistory::undo()
+{
+    if (document->isUndoAvailable() || !canUndo()) return false;
+
+    dropCheckpoint();
+    QString text = checkpointText(checkpoints.last());
+
+    restoring = true;
+    QTextCursor cursor(document);
+    cursor.beginEditBlock();
+    cursor.select(QTextCursor::Document);
+    cursor.insertText(text);
+    cursor.endEditBlock();
+    document->clearUndoRedoStacks();
+    restoring = false;
+    live = 0;
+    return true;
+}
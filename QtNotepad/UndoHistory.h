@@ -0,0 +1,59 @@
+#pragma once
+#include <QObject>
+#include <QTextDocument>
+#include <QTemporaryFile>
+#include <QByteArray>
+#include <QVector>
+
+class UndoHistory : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UndoHistory(QTextDocument*, QObject* parent = nullptr);
+    ~UndoHistory();
+
+    void setBudget(qint64);
+    static void setGlobalBudget(qint64);
+
+    bool undo();
+    bool canUndo() const;
+    qint64 liveBytes() const;
+    qint64 storedBytes() const;
+    qint64 spilledBytes() const;
+    int checkpointCount() const;
+    static qint64 globalStoredBytes();
+
+private slots:
+    void recordChange(int, int, int);
+    void trim();
+
+private:
+    struct Checkpoint
+    {
+        QByteArray data;
+        qint64 offset;
+        qint64 size;
+        int serial;
+        QString text;
+    };
+
+    void addCheckpoint(const QString&);
+    void compressed(int, const QByteArray&);
+    void spill();
+    QString checkpointText(const Checkpoint&);
+    void dropCheckpoint();
+
+    QTextDocument* document;
+    QVector<Checkpoint> checkpoints;
+    QTemporaryFile* spillFile;
+    qint64 budget;
+    qint64 live;
+    qint64 stored;
+    qint64 spilled;
+    int serials;
+    bool restoring;
+    bool trimming;
+
+    static qint64 globalBudget;
+    static qint64 globalStored;
+};
@@ -1,10 +1,39 @@
 #include "QtNotepad.h"
+#include "Benchmark.h"
+#include "Trace.h"
 #include <QtWidgets/QApplication>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
-    QtNotepad w;
-    w.show();
-    return a.exec();
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption benchmark("benchmark", "Run the benchmark suite and write the results to <file> (.json or .csv).", "file");
+    QCommandLineOption baseline("baseline", "Fail if any benchmark is slower than in <file>.", "file");
+    QCommandLineOption tolerance("tolerance", "Allowed slowdown against the baseline, in percent.", "percent", "20");
+    QCommandLineOption maxSize("max-size", "Largest synthetic file opened by the benchmark, in MB.", "size", "256");
+    QCommandLineOption trace("trace", "Record a Chrome trace of the session and write it to <file> on exit.", "file");
+    parser.addOptions({ benchmark, baseline, tolerance, maxSize, trace });
+    parser.process(a);
+
+    Trace::start(parser.isSet(trace) ? parser.value(trace) : qEnvironmentVariable("QTNOTEPAD_TRACE"));
+    int code = 0;
+
+    if (parser.isSet(benchmark))
+    {
+        Benchmark bench(parser.value(benchmark));
+        if (parser.isSet(baseline)) bench.setBaseline(parser.value(baseline), parser.value(tolerance).toDouble());
+        bench.setMaxSize(parser.value(maxSize).toLongLong() * 1024 * 1024);
+        code = bench.run();
+    }
+    else
+    {
+        QtNotepad w;
+        w.show();
+        code = a.exec();
+    }
+    Trace::write();
+    return code;
 }
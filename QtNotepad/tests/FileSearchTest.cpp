@@ -0,0 +1,44 @@
+#include "FileSearch.h"
+#include <QtTest>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QFile>
+#include <algorithm>
+
+class FileSearchTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void anchorsMatchEveryLine();
+};
+
+void FileSearchTest::anchorsMatchEveryLine()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QFile file(dir.filePath("sample.txt"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("foo first\nbar\nfoo third\n  foo indented\nfoo fifth\n");
+    file.close();
+
+    FileSearch search;
+    QVector<FileHit> hits;
+    connect(&search, &FileSearch::found, this, [&hits](const QVector<FileHit>& found) { hits += found; });
+    QSignalSpy finished(&search, &FileSearch::finished);
+
+    SearchQuery query;
+    query.pattern = "^foo";
+    query.regex = true;
+    query.sensitivity = Qt::CaseSensitive;
+    search.start(dir.path(), query, 1024 * 1024, 100);
+    QVERIFY(finished.wait(5000));
+
+    QVector<qint64> lines;
+    for (const FileHit& hit : hits) lines.append(hit.line);
+    std::sort(lines.begin(), lines.end());
+    QCOMPARE(lines, QVector<qint64>({ 1, 3, 5 }));
+}
+
+QTEST_MAIN(FileSearchTest)
+#include "FileSearchTest.moc"
@@ -0,0 +1,58 @@
+#include "UndoHistory.h"
+#include <QtTest>
+#include <QTextCursor>
+
+class UndoHistoryTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void budgetCrossingEditIsUndoable();
+    void earlierCheckpointsSurviveTrim();
+};
+
+void UndoHistoryTest::budgetCrossingEditIsUndoable()
+{
+    QTextDocument document;
+    const QString original = QString("line of text\n").repeated(1000);
+    document.setPlainText(original);
+    UndoHistory history(&document);
+    history.setBudget(1024);
+
+    QTextCursor cursor(&document);
+    cursor.select(QTextCursor::Document);
+    cursor.removeSelectedText();
+    QCoreApplication::processEvents();
+    QVERIFY(!document.isUndoAvailable());
+    QVERIFY(history.canUndo());
+
+    QVERIFY(history.undo());
+    QCOMPARE(document.toPlainText(), original);
+}
+
+void UndoHistoryTest::earlierCheckpointsSurviveTrim()
+{
+    QTextDocument document;
+    document.setPlainText("start");
+    UndoHistory history(&document);
+    history.setBudget(1024);
+
+    const QString first = QString("a").repeated(2000);
+    const QString second = QString("b").repeated(2000);
+    QTextCursor cursor(&document);
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(first);
+    QCoreApplication::processEvents();
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(second);
+    QCoreApplication::processEvents();
+
+    QVERIFY(history.undo());
+    QCOMPARE(document.toPlainText(), "start" + first);
+    QVERIFY(history.undo());
+    QCOMPARE(document.toPlainText(), QString("start"));
+    QVERIFY(!history.canUndo());
+}
+
+QTEST_MAIN(UndoHistoryTest)
+#include "UndoHistoryTest.moc"